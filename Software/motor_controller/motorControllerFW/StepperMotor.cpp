@@ -1,4 +1,5 @@
 #include "StepperMotor.h"
+#include "common/probes.h"
 // #include "./communication/SimpleFOCDebug.h"
 
 
@@ -48,13 +49,18 @@ int StepperMotor::init() {
   if(voltage_sensor_align > voltage_limit) voltage_sensor_align = voltage_limit;
 
   // update the controller limits
-  if(_isset(phase_resistance)){
+  PID_current_q.limit = voltage_limit;
+  PID_current_d.limit = voltage_limit;
+  if(_isset(phase_resistance) || torque_controller != TorqueControlType::voltage){
     // velocity control loop controls current
     PID_velocity.limit = current_limit;
   }else{
     PID_velocity.limit = voltage_limit;
   }
   P_angle.limit = velocity_limit;
+  // with loopFOC called once per PWM period, the duty it writes is loaded at the next wrap (the centre
+  // of the phase correct pulse) and held for that single pulse - FOCScheduler replaces this with its FOC rate
+  if(driver->pwm_frequency > 0) output_latency_auto = 1.0f/driver->pwm_frequency;
 
   // if using open loop control, set a CW as the default direction if not already set
   if ((controller==MotionControlType::angle_openloop
@@ -114,6 +120,7 @@ int  StepperMotor::initFOC() {
     // added the shaft_angle update
     sensor->update();
     shaft_angle = shaftAngle();
+    if (velocity_estimator) velocity_estimator->reset(sensor->getPreciseAngleTurns());
 
     // aligning the current sensor - can be skipped
     // checks if driver phases are the same as current sense phases
@@ -257,6 +264,67 @@ int StepperMotor::alignSensor() {
   return exit_flag;
 }
 
+// Sensor nonlinearity calibration with an open-loop sweep of one turn
+int StepperMotor::calibrateSensor(SensorCalibration* calibration, int steps_per_pole, int settle_ms, bool print_samples, Sensor* raw_sensor) {
+  Sensor* swept = raw_sensor ? raw_sensor : sensor;
+  if (!swept || !calibration || steps_per_pole < 4) return 0;
+  puts("MOT: Calibrate sensor.");
+  // the fit needs the raw angle
+  swept->calibration = nullptr;
+  calibration->begin();
+  float voltage_align = voltage_sensor_align;
+  int steps = pole_pairs * steps_per_pole;
+
+  // settle at electrical 0, then one electrical revolution forward to find the direction the sensor counts
+  setPhaseVoltage(voltage_align, 0, 0);
+  sleep_ms(500);
+  swept->update();
+  uint32_t start = swept->getMechanicalAngleTurns();
+  for (int i = 1; i <= steps_per_pole; i++) {
+    setPhaseVoltage(voltage_align, 0, _2PI * (i % steps_per_pole) / steps_per_pole);
+    sleep_ms(settle_ms);
+  }
+  sleep_ms(100);
+  swept->update();
+  int32_t moved = (int32_t)(swept->getMechanicalAngleTurns() - start);
+  // expected one pole pitch, 2^32 / pole_pairs
+  if (fabs(moved * (float)pole_pairs * (1.0f / 4294967296.0f)) < 0.5f) {
+    puts("MOT: Failed to notice movement");
+    setPhaseVoltage(0, 0, 0);
+    return 0;
+  }
+  bool reverse = moved < 0;
+
+  // one turn forward and back, every electrical step is one reference step of 2^32 / steps
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i <= steps; i++) {
+      int step = pass == 0 ? i : steps - i;
+      setPhaseVoltage(voltage_align, 0, _2PI * (step % steps_per_pole) / steps_per_pole);
+      sleep_ms(settle_ms);
+      swept->update();
+      uint32_t reference = (uint32_t)(((uint64_t)step << 32) / steps);
+      if (reverse) reference = 0u - reference;
+      uint32_t measured = swept->getMechanicalAngleTurns();
+      calibration->addSample(reference, measured);
+      if (print_samples) printf("CAL %d %" PRIu32 " %" PRIu32 "\n", pass, reference, measured);
+    }
+  }
+  setPhaseVoltage(0, 0, 0);
+  sleep_ms(200);
+
+  if (!calibration->fit()) {
+    puts("MOT: Sensor calibration failed, the sweep did not cover the turn");
+    return 0;
+  }
+  printf("MOT: Sensor error RMS %.4f -> %.4f deg, max correction %.4f deg\n",
+         calibration->rms_before * 180.0f / _PI, calibration->rms_after * 180.0f / _PI, calibration->max_correction * 180.0f / _PI);
+  swept->calibration = calibration;
+  // the raw angle is gone, restart the angle tracking from the corrected one
+  swept->update();
+  if (sensor && sensor != swept) sensor->update();
+  return 1;
+}
+
 // Encoder alignment the absolute zero angle
 // - to the index
 int StepperMotor::absoluteZeroSearch() {
@@ -291,10 +359,20 @@ int StepperMotor::absoluteZeroSearch() {
 // Iterative function looping FOC algorithm, setting Uq on the Motor
 // The faster it can be run the better
 void StepperMotor::loopFOC() {
-  
+  PROBE_SCOPE(PROBE_LOOPFOC);
+
   // update sensor - do this even in open-loop mode, as user may be switching between modes and we could lose track
   //                 of full rotations otherwise.
+  PROBE_START(sensor);
   if (sensor) sensor->update();
+  PROBE_END(sensor, PROBE_SENSOR_UPDATE);
+  updateVelocityEstimator();
+
+  // measured bus voltage for the volts to duty cycle conversion of the driver, so supply sag does not reduce torque
+  if(current_sense){
+    float bus_voltage = current_sense->updateBusVoltage();
+    if(_isset(bus_voltage) && bus_voltage > DEF_VBUS_COMPENSATION_MIN) driver->voltage_power_supply = bus_voltage;
+  }
 
   // if open-loop do nothing
   if( controller==MotionControlType::angle_openloop || controller==MotionControlType::velocity_openloop ) return;
@@ -303,9 +381,52 @@ void StepperMotor::loopFOC() {
   if(!enabled) return;
 
   // Needs the update() to be called first
-  // This function will not have numerical issues because it uses Sensor::getMechanicalAngle() 
-  // which is in range 0-2PI
-  electrical_angle = electricalAngle();
+  // This function will not have numerical issues because it uses Sensor::getMechanicalAngleTurns()
+  // which is a binary angle - the electrical angle is a single multiply, wrapped for free
+  PROBE_START(angle);
+  electrical_angle_turns = electricalAngleTurns();
+  electrical_angle = electrical_angle_turns * _TURNS32_TO_RAD;
+  PROBE_END(angle, PROBE_ELECTRICAL_ANGLE);
+  PROBE_START(torque);
+#if SIMPLEFOC_FIXED_POINT
+  // Q16.16 from the ADC frame to setPwmQ16, the float members are copies for the motion loop and the monitoring
+  if(current_sense && torque_controller == TorqueControlType::foc_current){
+    updateFixedOperands();
+    q15_t _sa, _ca;
+    _sincos_q15(electrical_angle_turns, &_sa, &_ca);
+    // expected alpha beta currents, the sign of magnitude only current sensing
+    current_sense->setCurrentReferenceQ16(_q16_mul_q15(current_sp_d_q, _ca) - _q16_mul_q15(current_sp_q, _sa),
+                                          _q16_mul_q15(current_sp_d_q, _sa) + _q16_mul_q15(current_sp_q, _ca));
+    DQCurrentQ16_s i = current_sense->getFOCCurrentsQ16(electrical_angle_turns);
+    current_raw.q = _q16_to_float(i.q);
+    current_raw.d = _q16_to_float(i.d);
+    // filter values
+    i.q = LPF_current_q.filterQ16(i.q);
+    i.d = LPF_current_d.filterQ16(i.d);
+    // calculate the phase voltages
+    q16_t uq = PID_current_q.stepQ16(_q16_sat((int64_t)current_sp_q - i.q));
+    q16_t ud = PID_current_d.stepQ16(_q16_sat((int64_t)current_sp_d_q - i.d));
+    // decoupling of the rotational voltages, as in the float version below
+    int64_t uq_sum = (int64_t)uq + _q16_mul(we_L_q, i.d) + voltage_bemf_q;
+    int64_t ud_sum = (int64_t)ud - _q16_mul(we_L_q, i.q);
+    uq = (q16_t)_constrain(uq_sum, -voltage_limit_q, voltage_limit_q);
+    ud = (q16_t)_constrain(ud_sum, -voltage_limit_q, voltage_limit_q);
+    current.q = _q16_to_float(i.q);
+    current.d = _q16_to_float(i.d);
+    voltage.q = _q16_to_float(uq);
+    voltage.d = _q16_to_float(ud);
+    PROBE_END(torque, PROBE_TORQUE_CONTROL);
+    setPhaseVoltageTurnsQ16(uq, ud, electrical_angle_turns + electricalAngleAdvance());
+    return;
+  }
+#endif
+  // expected alpha beta currents, the sign of magnitude only current sensing
+  if(current_sense && torque_controller != TorqueControlType::voltage){
+    float _sa, _ca;
+    _sincos(electrical_angle, &_sa, &_ca);
+    float id = (torque_controller == TorqueControlType::foc_current) ? current_sp_d : 0.0f;
+    current_sense->setCurrentReference(_ca*id - _sa*current_sp, _sa*id + _ca*current_sp);
+  }
   switch (torque_controller) {
     case TorqueControlType::voltage:
       // no need to do anything really
@@ -326,22 +447,33 @@ void StepperMotor::loopFOC() {
       if(!current_sense) return;
       // read dq currents
       current = current_sense->getFOCCurrents(electrical_angle);
+      current_raw = current;
       // filter values
       current.q = LPF_current_q(current.q);
       current.d = LPF_current_d(current.d);
       // calculate the phase voltages
       voltage.q = PID_current_q(current_sp - current.q);
-      voltage.d = PID_current_d(-current.d);
-      // d voltage - lag compensation - TODO verify
-      // if(_isset(phase_inductance)) voltage.d = _constrain( voltage.d - current_sp*shaft_velocity*pole_pairs*phase_inductance, -voltage_limit, voltage_limit);
+      voltage.d = PID_current_d(current_sp_d - current.d);
+      // decoupling of the rotational voltages, the PI controllers only see R and L
+      //   ud = R*id + L*did/dt - we*L*iq
+      //   uq = R*iq + L*diq/dt + we*L*id + bemf
+      if(_isset(phase_inductance)){
+        float we_L = shaft_velocity*pole_pairs*phase_inductance;
+        voltage.d -= we_L*current.q;
+        voltage.q += we_L*current.d;
+      }
+      voltage.q = _constrain(voltage.q + voltage_bemf, -voltage_limit, voltage_limit);
+      voltage.d = _constrain(voltage.d, -voltage_limit, voltage_limit);
       break;
     default:
       // no torque control selected    
       //puts("MOT: no torque control selected!");
       break;
   }
+  PROBE_END(torque, PROBE_TORQUE_CONTROL);
   // set the phase voltage - FOC heart function :)
-  setPhaseVoltage(voltage.q, voltage.d, electrical_angle);
+  // the measured currents go with the sensor angle, the voltage with the angle at the PWM output
+  setPhaseVoltageTurns(voltage.q, voltage.d, electrical_angle_turns + electricalAngleAdvance());
 }
 
 // Iterative function running outer loop of the FOC algorithm
@@ -357,6 +489,7 @@ void StepperMotor::move(float new_target) {
   // downsampling (optional)
   if(motion_cnt++ < motion_downsample) return;
   motion_cnt = 0;
+  PROBE_SCOPE(PROBE_MOVE);
 
   // shaft angle/velocity need the update() to be called first
   // get shaft angle
@@ -364,10 +497,13 @@ void StepperMotor::move(float new_target) {
   //                        For this reason it is NOT precise when the angles become large.
   //                        Additionally, the way LPF works on angle is a precision issue, and the angle-LPF is a problem
   //                        when switching to a 2-component representation.
+  //                        The exact multi-turn position is available as shaftAngleTurns().
+  PROBE_START(shaft);
   if( controller!=MotionControlType::angle_openloop && controller!=MotionControlType::velocity_openloop ) 
     shaft_angle = shaftAngle(); // read value even if motor is disabled to keep the monitoring updated but not in openloop mode
   // get angular velocity 
   shaft_velocity = shaftVelocity(); // read value even if motor is disabled to keep the monitoring updated
+  PROBE_END(shaft, PROBE_SHAFT_STATE);
 
   // if disabled do nothing
   if(!enabled) return;
@@ -378,6 +514,7 @@ void StepperMotor::move(float new_target) {
   // estimate the motor current if phase reistance available and current_sense not available
   if(!current_sense && _isset(phase_resistance)) current.q = (voltage.q - voltage_bemf)/phase_resistance;
 
+  PROBE_SCOPE(PROBE_MOTION_CONTROL);
    // upgrade the current based voltage limit
   switch (controller) {
     case MotionControlType::torque:
@@ -402,7 +539,8 @@ void StepperMotor::move(float new_target) {
       shaft_velocity_sp = feed_forward_velocity + P_angle( shaft_angle_sp - shaft_angle );
       shaft_velocity_sp = _constrain(shaft_velocity_sp,-velocity_limit, velocity_limit);
       // calculate the torque command - sensor precision: this calculation is ok, but based on bad value from previous calculation
-      current_sp = PID_velocity(shaft_velocity_sp - shaft_velocity); // if voltage torque control
+      current_sp = PID_velocity(shaft_velocity_sp - shaft_velocity) + torqueFeedForward(); // if voltage torque control
+      current_sp = _constrain(current_sp, -PID_velocity.limit, PID_velocity.limit);
       // if torque controlled through voltage
       if(torque_controller == TorqueControlType::voltage){
         // use voltage if phase-resistance not provided
@@ -417,7 +555,8 @@ void StepperMotor::move(float new_target) {
       // velocity set point - sensor precision: this calculation is numerically precise.
       shaft_velocity_sp = target;
       // calculate the torque command
-      current_sp = PID_velocity(shaft_velocity_sp - shaft_velocity); // if current/foc_current torque control
+      current_sp = PID_velocity(shaft_velocity_sp - shaft_velocity) + torqueFeedForward(); // if current/foc_current torque control
+      current_sp = _constrain(current_sp, -PID_velocity.limit, PID_velocity.limit);
       // if torque controlled through voltage control
       if(torque_controller == TorqueControlType::voltage){
         // use voltage if phase-resistance not provided
@@ -454,7 +593,12 @@ void StepperMotor::move(float new_target) {
 // Function using sine approximation
 // regular sin + cos ~300us    (no memory usaage)
 // approx  _sin + _cos ~110us  (400Byte ~ 20% of memory)
+// _sincos: one table lookup for both, index/fraction split by the SIO interpolator on the RP2040
 void StepperMotor::setPhaseVoltage(float Uq, float Ud, float angle_el) {
+#if SIMPLEFOC_FIXED_POINT
+  // angle to 16 bit binary angle - one float multiply, wraparound and negative angles come for free
+  setPhaseVoltageTurns(Uq, Ud, (uint32_t)((int32_t)(angle_el * _RAD_TO_TURNS16)) << 16);
+#else
   // Sinusoidal PWM modulation
   // Inverse Park transformation
   float _sa, _ca;
@@ -466,7 +610,61 @@ void StepperMotor::setPhaseVoltage(float Uq, float Ud, float angle_el) {
 
   // set the voltages in hardware
   driver->setPwm(Ualpha, Ubeta);
+#endif
+}
+
+// Binary angle version - the upper bits of the angle index the sine table directly
+void StepperMotor::setPhaseVoltageTurns(float Uq, float Ud, uint32_t angle_el) {
+#if SIMPLEFOC_FIXED_POINT
+  setPhaseVoltageTurnsQ16(_float_to_q16(Uq), _float_to_q16(Ud), angle_el);
+#else
+  PROBE_START(sincos);
+  q15_t _sa, _ca;
+  _sincos_q15(angle_el, &_sa, &_ca);
+  PROBE_END(sincos, PROBE_SINCOS);
+  PROBE_SCOPE(PROBE_SET_PWM);
+  float sa = _sa * (1.0f/32768.0f);
+  float ca = _ca * (1.0f/32768.0f);
+  // Inverse park transform
+  Ualpha =  ca * Ud - sa * Uq;  // -sin(angle) * Uq;
+  Ubeta =  sa * Ud + ca * Uq;    //  cos(angle) * Uq;
+
+  // set the voltages in hardware
+  driver->setPwm(Ualpha, Ubeta);
+#endif
+}
+
+#if SIMPLEFOC_FIXED_POINT
+void StepperMotor::setPhaseVoltageTurnsQ16(q16_t Uq, q16_t Ud, uint32_t angle_el) {
+  PROBE_START(sincos);
+  q15_t _sa, _ca;
+  _sincos_q15(angle_el, &_sa, &_ca);
+  PROBE_END(sincos, PROBE_SINCOS);
+  PROBE_SCOPE(PROBE_SET_PWM);
+  // Inverse park transform
+  q16_t Ualpha_q = _q16_mul_q15(Ud, _ca) - _q16_mul_q15(Uq, _sa);  // -sin(angle) * Uq;
+  q16_t Ubeta_q = _q16_mul_q15(Ud, _sa) + _q16_mul_q15(Uq, _ca);    //  cos(angle) * Uq;
+  Ualpha = _q16_to_float(Ualpha_q);
+  Ubeta = _q16_to_float(Ubeta_q);
+
+  // set the voltages in hardware
+  driver->setPwmQ16(Ualpha_q, Ubeta_q);
+}
+
+// the operands are public floats written at the motion rate (or by the user), so their bit patterns
+// are compared every FOC step and the conversions only run when one of them changed
+void StepperMotor::updateFixedOperands() {
+  uint32_t bits[6] = {_float_bits(current_sp), _float_bits(current_sp_d), _float_bits(voltage_bemf),
+                      _float_bits(voltage_limit), _float_bits(shaft_velocity), _float_bits(phase_inductance)};
+  if(!memcmp(bits, operand_bits, sizeof(bits))) return;
+  memcpy(operand_bits, bits, sizeof(bits));
+  current_sp_q = _float_to_q16(current_sp);
+  current_sp_d_q = _float_to_q16(current_sp_d);
+  voltage_bemf_q = _isset(KV_rating) ? _float_to_q16(voltage_bemf) : 0;
+  voltage_limit_q = _float_to_q16(voltage_limit);
+  we_L_q = _isset(phase_inductance) ? _float_to_q16(shaft_velocity*pole_pairs*phase_inductance) : 0;
 }
+#endif
 
 // Function (iterative) generating open loop movement for target velocity
 // - target_velocity - rad/s
@@ -55,6 +55,20 @@
       * - If zero_electric_offset parameter is set the alignment procedure is skipped
       */  
      int initFOC() override;
+     /**
+      * Sensor nonlinearity calibration
+      * Steps one mechanical turn open-loop forward and back at voltage_sensor_align and fits the
+      * correction of the sensor angle (the load lag cancels between the two directions).
+      * Call it after init() and before initFOC(), so the alignment already sees the corrected angle.
+      * 
+      * @param calibration - fitted in place and linked to the sensor on success
+      * @param steps_per_pole - open-loop steps per electrical revolution
+      * @param settle_ms - wait after every step before the sensor is read
+      * @param print_samples - print every sample as "CAL pass reference measured" for host/sensor_calibration_fit
+      * @param raw_sensor - sensor sampled and linked to the calibration, the motor's sensor if nullptr;
+      *                     a sensor switching between sources has to be calibrated on the one it follows
+      */
+     int calibrateSensor(SensorCalibration* calibration, int steps_per_pole = 32, int settle_ms = 2, bool print_samples = false, Sensor* raw_sensor = nullptr);
      /**
       * Function running FOC algorithm in real-time
       * it calculates the gets motor angle and sets the appropriate voltages 
@@ -81,6 +95,24 @@
      * @param angle_el current electrical angle of the motor
      */
      void setPhaseVoltage(float Uq, float Ud, float angle_el) override;
+   /**
+     * Method using FOC to set Uq to the motor at the optimal angle, given as a binary angle
+     * 
+     * @param Uq Current voltage in q axis to set to the motor
+     * @param Ud Current voltage in d axis to set to the motor
+     * @param angle_el current electrical angle of the motor, 2^32 is one electrical turn
+     */
+     void setPhaseVoltageTurns(float Uq, float Ud, uint32_t angle_el) override;
+#if SIMPLEFOC_FIXED_POINT
+    /**
+     * setPhaseVoltageTurns() on Q16.16 voltages, the end of the fixed point current loop
+     * 
+     * @param Uq q axis voltage in Q16.16
+     * @param Ud d axis voltage in Q16.16
+     * @param angle_el current electrical angle of the motor, 2^32 is one electrical turn
+     */
+     void setPhaseVoltageTurnsQ16(q16_t Uq, q16_t Ud, uint32_t angle_el);
+#endif
  
    private:
    
@@ -108,6 +140,17 @@
      float angleOpenloop(float target_angle);
      // open loop variables
      long open_loop_timestamp;
+
+#if SIMPLEFOC_FIXED_POINT
+     /** refresh the Q16.16 copies of the motion rate operands of the current loop if their bit patterns changed */
+     void updateFixedOperands();
+     uint32_t operand_bits[6] = {0}; //!< bit patterns of current_sp, current_sp_d, voltage_bemf, voltage_limit, shaft_velocity, phase_inductance
+     q16_t current_sp_q = 0; //!< current_sp in Q16.16
+     q16_t current_sp_d_q = 0; //!< current_sp_d in Q16.16
+     q16_t voltage_bemf_q = 0; //!< voltage_bemf in Q16.16
+     q16_t voltage_limit_q = 0; //!< voltage_limit in Q16.16
+     q16_t we_L_q = 0; //!< electrical velocity x phase inductance in Q16.16, 0 if the inductance is not set
+#endif
  };
  
  
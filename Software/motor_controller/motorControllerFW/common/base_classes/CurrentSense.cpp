@@ -123,6 +123,51 @@ void CurrentSense::disable(){
     // nothing is done here, but you can override this function
 };
 
+float CurrentSense::updateBusVoltage(){
+    // no bus voltage measurement by default
+    return NOT_SET;
+};
+
+void CurrentSense::setCurrentReference(float alpha, float beta){
+    reference_sign_alpha = _sign(alpha);
+    reference_sign_beta = _sign(beta);
+    current_reference_set = true;
+};
+
+void CurrentSense::setCurrentReferenceQ16(q16_t alpha, q16_t beta){
+    reference_sign_alpha = _sign(alpha);
+    reference_sign_beta = _sign(beta);
+    current_reference_set = true;
+};
+
+PhaseCurrentQ16_s CurrentSense::getPhaseCurrentsQ16(){
+    PhaseCurrent_s current = getPhaseCurrents();
+    PhaseCurrentQ16_s current_q;
+    current_q.a = _float_to_q16(current.a);
+    current_q.b = _float_to_q16(current.b);
+    current_q.c = _float_to_q16(current.c);
+    return current_q;
+};
+
+DQCurrentQ16_s CurrentSense::getFOCCurrentsQ16(uint32_t angle_el){
+    DQCurrentQ16_s return_current;
+    // the Clarke transform of the BLDC motors stays in float
+    if (driver_type != DriverType::Stepper){
+        DQCurrent_s current = getFOCCurrents(angle_el * _TURNS32_TO_RAD);
+        return_current.d = _float_to_q16(current.d);
+        return_current.q = _float_to_q16(current.q);
+        return return_current;
+    }
+    // stepper: the phase currents are the alpha beta currents
+    PhaseCurrentQ16_s current = getPhaseCurrentsQ16();
+    q15_t st, ct;
+    _sincos_q15(angle_el, &st, &ct);
+    // park transform
+    return_current.d = _q16_mul_q15(current.a, ct) + _q16_mul_q15(current.b, st);
+    return_current.q = _q16_mul_q15(current.b, ct) - _q16_mul_q15(current.a, st);
+    return return_current;
+}
+
 
 // Function aligning the current sense with motor driver
 // if all pins are connected well none of this is really necessary! - can be avoided
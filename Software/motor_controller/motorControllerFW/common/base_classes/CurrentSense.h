@@ -126,6 +126,42 @@ class CurrentSense{
      */
     virtual void disable();
 
+    /**
+     * Function reading and filtering the bus (power supply) voltage, if the current sense converts it
+     *   It is called once per loopFOC(), the result is used for the volts to duty cycle conversion of the driver
+     *   The default implementation has no bus voltage measurement and returns NOT_SET
+     * 
+     * @return filtered bus voltage [V] or NOT_SET
+     */
+    virtual float updateBusVoltage();
+    /**
+     * Expected alpha and beta currents of this FOC step (inverse Park of the current setpoints), set by the motor
+     *   before reading the currents - used for the sign of current sensing that only measures the magnitude
+     * 
+     * @param alpha - expected alpha current [A]
+     * @param beta - expected beta current [A]
+     */
+    void setCurrentReference(float alpha, float beta);
+    /** setCurrentReference() on Q16.16 currents */
+    void setCurrentReferenceQ16(q16_t alpha, q16_t beta);
+    int8_t reference_sign_alpha = 0; //!< sign of the expected alpha current of this step, 0 if it is 0
+    int8_t reference_sign_beta = 0; //!< sign of the expected beta current of this step, 0 if it is 0
+    bool current_reference_set = false; //!< true once the motor sets the current reference
+
+    /**
+     * Fixed point variant of getPhaseCurrents(), for the SIMPLEFOC_FIXED_POINT pipeline
+     *   The default implementation converts the result of getPhaseCurrents()
+     * 
+     * @return PhaseCurrentQ16_s current values in Q16.16
+     */
+    virtual PhaseCurrentQ16_s getPhaseCurrentsQ16();
+    /**
+     * Fixed point variant of getFOCCurrents(), Park transform on a binary angle
+     * 
+     * @param angle_el - motor electrical angle, 2^32 is one electrical turn
+     */
+    DQCurrentQ16_s getFOCCurrentsQ16(uint32_t angle_el);
+
     /**
      * Function used to align the current sense with the BLDC motor driver
     */
@@ -29,6 +29,8 @@ FOCMotor::FOCMotor()
   current_sp = 0;
   current.q = 0;
   current.d = 0;
+  current_raw.q = 0;
+  current_raw.d = 0;
 
   // voltage bemf 
   voltage_bemf = 0;
@@ -61,6 +63,95 @@ void FOCMotor::linkCurrentSense(CurrentSense* _current_sense) {
   current_sense = _current_sense;
 }
 
+void FOCMotor::linkVelocityEstimator(VelocityEstimator* _velocity_estimator) {
+  velocity_estimator = _velocity_estimator;
+}
+
+void FOCMotor::setSampleTimes(float foc_Ts, float motion_Ts) {
+  // current loop, run in loopFOC()
+  PID_current_q.setSampleTime(foc_Ts);
+  PID_current_d.setSampleTime(foc_Ts);
+  LPF_current_q.setSampleTime(foc_Ts);
+  LPF_current_d.setSampleTime(foc_Ts);
+  velocity_estimator_Ts = (foc_Ts > 0.0f) ? foc_Ts : 0.0f;
+  velocity_estimator_ts = time_us_64();
+  // motion control, run every motion_downsample+1 move() calls
+  float Ts = motion_Ts * (motion_downsample + 1);
+  PID_velocity.setSampleTime(Ts);
+  P_angle.setSampleTime(Ts);
+  LPF_velocity.setSampleTime(Ts);
+  LPF_angle.setSampleTime(Ts);
+}
+
+// current PI tuning by pole zero cancellation
+int FOCMotor::tuneCurrentController(float bandwidth) {
+  if(!_isset(phase_resistance) || !_isset(phase_inductance) || bandwidth <= 0.0f) return 0;
+  PID_current_q.P = PID_current_d.P = phase_inductance*bandwidth;
+  PID_current_q.I = PID_current_d.I = phase_resistance*bandwidth;
+  PID_current_q.D = PID_current_d.D = 0;
+  PID_current_q.output_ramp = PID_current_d.output_ramp = 0;
+  LPF_current_q.Tf = LPF_current_d.Tf = 0.2f/bandwidth;
+  current_bandwidth = bandwidth;
+  return 1;
+}
+
+// d current step response
+float FOCMotor::measureCurrentBandwidth(float step) {
+  if(!current_sense || torque_controller != TorqueControlType::foc_current || !enabled) return NOT_SET;
+  // written by loopFOC() in the interrupt, before LPF_current_d so that its lag is not measured
+  volatile float* current_d = &current_raw.d;
+  current_sp_d = 0;
+  sleep_ms(20);
+  float start = *current_d;
+  float threshold = start + 0.632f*(step - start);
+  float bandwidth = NOT_SET;
+  uint64_t t0 = time_us_64();
+  current_sp_d = step;
+  while(time_us_64() - t0 < 100000) {
+    float i = *current_d;
+    if((step > start && i >= threshold) || (step < start && i <= threshold)) {
+      bandwidth = 1e6f/(time_us_64() - t0);
+      break;
+    }
+  }
+  current_sp_d = 0;
+  return bandwidth;
+}
+
+// torque feed forward
+float FOCMotor::torqueFeedForward() {
+  // the model based terms need the torque command to be a current
+  bool torque_is_current = _isset(KV_rating) && (torque_controller != TorqueControlType::voltage || _isset(phase_resistance));
+  float acceleration_gain = feed_forward_acceleration_gain;
+  if(!_isset(acceleration_gain)) acceleration_gain = (torque_is_current && _isset(inertia)) ? inertia/torqueConstant() : 0.0f;
+  float ff = feed_forward_torque + acceleration_gain*feed_forward_acceleration;
+  // load torque compensation
+  if(load_torque_compensation > 0.0f && torque_is_current)
+    ff += load_torque_compensation*estimated_load_torque/torqueConstant();
+  return ff;
+}
+
+// torque constant Kt = Ke = 1/(KV*sqrt(3)) in SI units
+float FOCMotor::torqueConstant() {
+  if(!_isset(KV_rating)) return NOT_SET;
+  return 1.0f/(KV_rating*_SQRT3*_RPM_TO_RADS);
+}
+
+// electromagnetic torque from the q current
+float FOCMotor::electromagneticTorque() {
+  if(!_isset(KV_rating)) return 0.0f;
+  float iq;
+  // current.q is only refreshed by loopFOC in the current torque modes
+  if(current_sense && torque_controller != TorqueControlType::voltage) iq = current.q;
+  else if(_isset(phase_resistance)) {
+    // estimated current - the back-emf from the estimated velocity of this FOC step
+    float velocity = velocity_estimator ? sensor_direction*velocity_estimator->velocity : shaft_velocity;
+    iq = (voltage.q - velocity/(KV_rating*_SQRT3)/_RPM_TO_RADS)/phase_resistance;
+  }
+  else return 0.0f;
+  return torqueConstant()*iq;
+}
+
 // shaft angle calculation
 float FOCMotor::shaftAngle() {
   // if no sensor linked return previous value ( for open loop )
@@ -71,13 +162,60 @@ float FOCMotor::shaftAngle() {
 float FOCMotor::shaftVelocity() {
   // if no sensor linked return previous value ( for open loop )
   if(!sensor) return shaft_velocity;
+  // the estimator does its own filtering
+  if(velocity_estimator) return sensor_direction*velocity_estimator->velocity;
   return sensor_direction*LPF_velocity(sensor->getVelocity());
 }
 
+// velocity estimator update
+void FOCMotor::updateVelocityEstimator() {
+  if(!velocity_estimator || !sensor) return;
+  float Ts = velocity_estimator_Ts;
+  if(Ts <= 0.0f) {
+    unsigned long now_us = time_us_64();
+    Ts = (now_us - velocity_estimator_ts) * 1e-6f;
+    velocity_estimator_ts = now_us;
+  }
+  // the model input and the load torque are in the sensor direction
+  if(_isset(inertia)) velocity_estimator->acceleration_input = sensor_direction*electromagneticTorque()/inertia;
+  velocity_estimator->update(sensor->getPreciseAngleTurns(), Ts);
+  if(_isset(inertia)) estimated_load_torque = -sensor_direction*inertia*velocity_estimator->disturbance();
+}
+
+// exact multi-turn shaft position
+int64_t FOCMotor::shaftAngleTurns() {
+  // if no sensor linked return the open loop angle
+  if(!sensor) return (int64_t)((double)shaft_angle * _RAD_TO_TURNS32);
+  return sensor_direction*sensor->getPreciseAngleTurns();
+}
+
 float FOCMotor::electricalAngle(){
   // if no sensor linked return previous value ( for open loop )
   if(!sensor) return electrical_angle;
-  return  _normalizeAngle( (float)(sensor_direction * pole_pairs) * sensor->getMechanicalAngle()  - zero_electric_angle );
+  return  electricalAngleTurns() * _TURNS32_TO_RAD;
+}
+
+uint32_t FOCMotor::electricalAngleTurns(){
+  // if no sensor linked return previous value ( for open loop )
+  if(!sensor) return electrical_angle_turns;
+  // zero_electric_angle is a public float, so its binary angle is refreshed lazily when it changes
+  if(zero_electric_angle != zero_electric_angle_cache){
+    zero_electric_angle_cache = zero_electric_angle;
+    zero_electric_angle_turns = (uint32_t)(int64_t)(zero_electric_angle * _RAD_TO_TURNS32);
+  }
+  // the multiply wraps modulo one electrical turn, so no normalisation is needed
+  return (uint32_t)(sensor_direction * pole_pairs) * sensor->getMechanicalAngleTurns() - zero_electric_angle_turns;
+}
+
+int32_t FOCMotor::electricalAngleAdvance(){
+  if(!sensor || !latency_compensation) return 0;
+  // measured every step, the sensor dates its angle back to the physical sample
+  angle_latency = sensor->getAngleAge()*1e-6f + (_isset(output_latency) ? output_latency : output_latency_auto);
+  // a stalled sensor is not extrapolated any further
+  if(angle_latency > DEF_ANGLE_LATENCY_MAX) angle_latency = DEF_ANGLE_LATENCY_MAX;
+  float velocity = velocity_estimator ? sensor_direction*velocity_estimator->velocity : shaft_velocity;
+  // through int64 so that advances over half a turn wrap instead of overflowing
+  return (int32_t)(int64_t)(velocity*pole_pairs*angle_latency*_RAD_TO_TURNS32);
 }
 
 /**
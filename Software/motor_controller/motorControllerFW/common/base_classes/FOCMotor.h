@@ -3,6 +3,7 @@
 
 #include "Sensor.h"
 #include "CurrentSense.h"
+#include "VelocityEstimator.h"
 
 #include "../foc_utils.h"
 #include "../defaults.h"
@@ -96,6 +97,44 @@ class FOCMotor
      */
     void linkCurrentSense(CurrentSense* current_sense);
 
+    /**
+     * Function linking a motor and a velocity estimator
+     * 
+     * @param velocity_estimator VelocityEstimator updated in loopFOC(), replaces the low pass filtered sensor velocity
+     */
+    void linkVelocityEstimator(VelocityEstimator* velocity_estimator);
+
+    /**
+     * Switch the controllers and filters to fixed sample time mode, for loops run at a constant rate
+     * 
+     * @param foc_Ts    period of loopFOC() [s] - current PIDs and filters
+     * @param motion_Ts period of the move() calls [s] - velocity/angle controllers and filters,
+     *                  the motion_downsample ratio is applied on top
+     * 
+     * - 0 for both goes back to measuring the time between the calls
+     */
+    void setSampleTimes(float foc_Ts, float motion_Ts);
+
+    /**
+     * Tune the dq current PI controllers for a closed loop bandwidth, by pole zero cancellation:
+     * P = L*bandwidth, I = R*bandwidth, the integrator zero cancels the R/L pole of the phase
+     * and the closed loop is first order with the time constant 1/bandwidth.
+     * The current filters are set 5 times faster than the loop.
+     * 
+     * @param bandwidth current loop bandwidth [rad/s], has to stay well below the loopFOC() rate
+     * @returns 1 on success, 0 if phase_resistance or phase_inductance is not set
+     */
+    int tuneCurrentController(float bandwidth);
+    /**
+     * Measure the achieved current loop bandwidth with a step of the d current, which produces no torque
+     * - needs foc_current torque control with loopFOC() running from an interrupt (FOCScheduler), blocks for up to 100ms
+     * - measured on the unfiltered d current, the current low pass filter would add its own lag
+     * 
+     * @param step d current step [A]
+     * @returns 1/(time to 63% of the step) [rad/s], NOT_SET if the step was not reached
+     */
+    float measureCurrentBandwidth(float step);
+
 
     /**
      * Function initializing FOC algorithm
@@ -130,6 +169,15 @@ class FOCMotor
     * @param angle_el current electrical angle of the motor
     */
     virtual void setPhaseVoltage(float Uq, float Ud, float angle_el)=0;
+    /**
+    * Same as setPhaseVoltage, with the electrical angle as a binary angle
+    * which indexes the sine table directly
+    * 
+    * @param Uq Current voltage in q axis to set to the motor
+    * @param Ud Current voltage in d axis to set to the motor
+    * @param angle_el current electrical angle of the motor, 2^32 is one electrical turn
+    */
+    virtual void setPhaseVoltageTurns(float Uq, float Ud, uint32_t angle_el)=0;
     
     // State calculation methods 
     /** Shaft angle calculation in radians [rad] */
@@ -139,6 +187,11 @@ class FOCMotor
      * It implements low pass filtering
      */
     float shaftVelocity();
+    /**
+     * Exact multi-turn shaft position as a binary angle (2^32 per turn, full rotations in the upper bits)
+     * with the sensor direction applied. Not filtered and without the sensor_offset.
+     */
+    int64_t shaftAngleTurns();
 
 
 
@@ -146,18 +199,60 @@ class FOCMotor
      * Electrical angle calculation  
      */
     float electricalAngle();
+    /** 
+     * Electrical angle calculation as a binary angle (2^32 per electrical turn)
+     * - one integer multiply by the pole pairs, wraparound is free
+     */
+    uint32_t electricalAngleTurns();
+    /** 
+     * Electrical angle travelled from the sensor sample to the PWM output applying the voltage, as a binary angle
+     * - shaft velocity x (measured age of the sensor angle + output_latency or output_latency_auto), updates angle_latency
+     * - 0 if latency_compensation is off
+     */
+    int32_t electricalAngleAdvance();
+    /** 
+     * Feed the latest sensor angle to the velocity estimator, if one is linked
+     * - called after the sensor update in loopFOC()
+     */
+    void updateVelocityEstimator();
+    /** 
+     * Torque constant Kt [Nm/A] from the KV rating, matching the back-emf constant used in move()
+     * - NOT_SET if KV_rating is not set
+     */
+    float torqueConstant();
+    /** 
+     * Electromagnetic torque [Nm] from the measured q current, or without current sensing
+     * (or in voltage torque mode, where the current is not read) from voltage.q, phase_resistance and the back-emf
+     * - 0 if the motor constants needed are not set
+     */
+    float electromagneticTorque();
+    /** 
+     * Torque feed forward of the velocity and angle loops, added to the velocity PID output
+     * feed_forward_torque + feed_forward_acceleration_gain*feed_forward_acceleration
+     * - without an acceleration gain set, it is inertia/torqueConstant() when both are known (torque as a current)
+     */
+    float torqueFeedForward();
 
     // state variables
     float target; //!< current target value - depends of the controller
     float feed_forward_velocity = 0.0f; //!< current feed forward velocity
+    float feed_forward_acceleration = 0.0f; //!< current feed forward acceleration [rad/s^2]
+    float feed_forward_torque = 0.0f; //!< current feed forward torque, in the units of current_sp
+    float feed_forward_acceleration_gain = NOT_SET; //!< torque per acceleration in the units of current_sp per rad/s^2, NOT_SET for J/Kt from inertia and KV_rating
+    float estimated_load_torque = 0.0f; //!< load torque from the velocity estimator [Nm], needs inertia and a model based estimator
+    float load_torque_compensation = 0.0f; //!< fraction of estimated_load_torque added to the torque feed forward (0 - off, 1 - full)
   	float shaft_angle;//!< current motor angle
   	float electrical_angle;//!< current electrical angle
+  	uint32_t electrical_angle_turns = 0;//!< current electrical angle as a binary angle
+    float angle_latency = 0.0f;//!< latency compensated in the last FOC step [s]
   	float shaft_velocity;//!< current motor velocity 
     float current_sp;//!< target current ( q current )
+    float current_sp_d = 0.0f;//!< target d current, 0 for the maximum torque per amp
     float shaft_velocity_sp;//!< current target velocity
     float shaft_angle_sp;//!< current target angle
     DQVoltage_s voltage;//!< current d and q voltage set to the motor
     DQCurrent_s current;//!< current d and q current measured
+    DQCurrent_s current_raw;//!< d and q current measured, before the current low pass filters (foc_current mode)
     float voltage_bemf; //!< estimated backemf voltage (if provided KV constant)
     float	Ualpha, Ubeta; //!< Phase voltages U alpha and U beta used for inverse Park and Clarke transform
 
@@ -165,12 +260,17 @@ class FOCMotor
     // motor configuration parameters
     float voltage_sensor_align;//!< sensor and motor align voltage parameter
     float velocity_index_search;//!< target velocity for index search 
+    bool latency_compensation = true;//!< extrapolate the electrical angle over the latency from the sensor sample to the PWM output
+    float output_latency = NOT_SET;//!< mean time from the FOC step to the centre of the PWM pulses applying its voltage [s], output_latency_auto if not set
+    float output_latency_auto = 0.0f;//!< output latency derived from the PWM frequency and the FOC rate (init(), FOCScheduler) [s]
     
     // motor physical parameters
     float	phase_resistance; //!< motor phase resistance
     int pole_pairs;//!< motor pole pairs number
     float KV_rating; //!< motor KV rating
     float	phase_inductance; //!< motor phase inductance
+    float current_bandwidth = NOT_SET; //!< current loop bandwidth the current controllers were tuned for [rad/s]
+    float inertia = NOT_SET; //!< rotor and load inertia [kg m^2]
 
     // limiting variables
     float voltage_limit; //!< Voltage limiting variable - global limit
@@ -240,10 +340,18 @@ class FOCMotor
       * CurrentSense link
     */
     CurrentSense* current_sense; 
+    /** 
+      * VelocityEstimator link, optional
+    */
+    VelocityEstimator* velocity_estimator = nullptr;
 
     // monitoring functions
     // Print* monitor_port; //!< Serial terminal variable if provided
   private:
+    float zero_electric_angle_cache = NOT_SET; //!< zero_electric_angle the binary angle below was computed from
+    uint32_t zero_electric_angle_turns = 0; //!< zero_electric_angle as a binary angle
+    float velocity_estimator_Ts = 0.0f; //!< fixed velocity estimator sample time [s], 0 if measured
+    unsigned long velocity_estimator_ts = 0; //!< last velocity estimator update timestamp
     // monitor counting variable
     unsigned int monitor_cnt = 0 ; //!< counting variable
 };
@@ -1,14 +1,33 @@
 #include "Sensor.h"
 
 void Sensor::update() {
-    float val = getSensorAngle();
+    int64_t val = getSensorAngleTurns();
     if (val<0) // sensor angles are strictly non-negative. Negative values are used to signal errors.
         return; // TODO signal error, e.g. via a flag and counter
-    angle_prev_ts = time_us_64();
-    float d_angle = val - angle_prev;
-    // if overflow happened track it as full rotation
-    if(abs(d_angle) > (0.8f*_2PI) ) full_rotations += ( d_angle > 0 ) ? -1 : 1; 
-    angle_prev = val;
+    angle_prev_ts = time_us_64() - getSensorAngleAge();
+    uint32_t turns = (uint32_t)val;
+    if (calibration) turns = calibration->correct(turns);
+    // shortest signed distance from the previous angle - exact as long as the shaft moves less than half a turn per update
+    int32_t d_angle = (int32_t)(turns - angle_prev_turns);
+    // if the angle wrapped on the way, track it as a full rotation
+    if(d_angle > 0 && turns < angle_prev_turns) full_rotations += 1;
+    else if(d_angle < 0 && turns > angle_prev_turns) full_rotations -= 1;
+    angle_prev_turns = turns;
+    angle_prev = turns * _TURNS32_TO_RAD;
+}
+
+
+// angle read on the spot - sensors sampling in the background override this
+uint32_t Sensor::getSensorAngleAge() {
+    return 0;
+}
+
+
+// binary angle from the float angle - sensors reading a raw count override this
+int64_t Sensor::getSensorAngleTurns() {
+    float val = getSensorAngle();
+    if (val<0) return -1;
+    return (int64_t)(val * _RAD_TO_TURNS32) & 0xFFFFFFFF;
 }
 
 
@@ -18,14 +37,18 @@ float Sensor::getVelocity() {
     float Ts = (angle_prev_ts - vel_angle_prev_ts)*1e-6f; // convert to seconds
     if (Ts < 0.0f) {    // handle micros() overflow - we need to reset vel_angle_prev_ts
         vel_angle_prev = angle_prev;
+        vel_angle_prev_turns = angle_prev_turns;
         vel_full_rotations = full_rotations;
         vel_angle_prev_ts = angle_prev_ts;
         return velocity;
     }
     if (Ts < min_elapsed_time) return velocity; // don't update velocity if deltaT is too small
 
-    velocity = ( (float)(full_rotations - vel_full_rotations)*_2PI + (angle_prev - vel_angle_prev) ) / Ts;
+    // the angle difference is exact in binary angles, only the result is converted
+    int64_t d_angle = (int64_t)(full_rotations - vel_full_rotations) * 4294967296LL + (int64_t)angle_prev_turns - (int64_t)vel_angle_prev_turns;
+    velocity = (float)d_angle * _TURNS32_TO_RAD / Ts;
     vel_angle_prev = angle_prev;
+    vel_angle_prev_turns = angle_prev_turns;
     vel_full_rotations = full_rotations;
     vel_angle_prev_ts = angle_prev_ts;
     return velocity;
@@ -35,18 +58,26 @@ float Sensor::getVelocity() {
 
 void Sensor::init() {
     // initialize all the internal variables of Sensor to ensure a "smooth" startup (without a 'jump' from zero)
-    getSensorAngle(); // call once
+    getSensorAngleTurns(); // call once
     sleep_us(1);
-    vel_angle_prev = getSensorAngle(); // call again
+    vel_angle_prev_turns = (uint32_t)getSensorAngleTurns(); // call again
+    vel_angle_prev = vel_angle_prev_turns * _TURNS32_TO_RAD;
     vel_angle_prev_ts = time_us_64();
     sleep_ms(1);
-    getSensorAngle(); // call once
+    getSensorAngleTurns(); // call once
     sleep_us(1);
-    angle_prev = getSensorAngle(); // call again
+    angle_prev_turns = (uint32_t)getSensorAngleTurns(); // call again
+    angle_prev = angle_prev_turns * _TURNS32_TO_RAD;
     angle_prev_ts = time_us_64();
 }
 
 
+uint32_t Sensor::getAngleAge() {
+    // modulo 2^32, angle_prev_ts is truncated to a long
+    return (uint32_t)time_us_64() - (uint32_t)angle_prev_ts;
+}
+
+
 float Sensor::getMechanicalAngle() {
     return angle_prev;
 }
@@ -60,7 +91,19 @@ float Sensor::getAngle(){
 
 
 double Sensor::getPreciseAngle() {
-    return (double)full_rotations * (double)_2PI + (double)angle_prev;
+    return (double)getPreciseAngleTurns() * ((double)_2PI / 4294967296.0);
+}
+
+
+
+uint32_t Sensor::getMechanicalAngleTurns() {
+    return angle_prev_turns;
+}
+
+
+
+int64_t Sensor::getPreciseAngleTurns() {
+    return (int64_t)full_rotations * 4294967296LL + angle_prev_turns;
 }
 
 
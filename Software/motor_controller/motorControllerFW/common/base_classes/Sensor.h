@@ -3,6 +3,7 @@
 
 #include <inttypes.h>
 #include "common/foc_utils.h"
+#include "common/sensor_calibration.h"
 
 /**
  *  Direction structure
@@ -31,7 +32,8 @@ enum Pullup : uint8_t {
  * 
  * To implement your own sensors, create a sub-class of this class, and implement the getSensorAngle()
  * method. getSensorAngle() returns a float value, in radians, representing the current shaft angle in the
- * range 0 to 2*PI (one full turn). 
+ * range 0 to 2*PI (one full turn). Sensors reading a raw count should also override getSensorAngleTurns(),
+ * which returns the angle as a binary angle (2^32 per turn) - internally the angle is tracked in that form.
  * 
  * To function correctly, the sensor class update() method has to be called sufficiently quickly. Normally,
  * the BLDCMotor's loopFOC() function calls it once per iteration, so you must ensure to call loopFOC() quickly
@@ -70,6 +72,27 @@ class Sensor{
          */
         virtual double getPreciseAngle();
 
+        /**
+         * Get mechanical shaft angle as a binary angle, the full uint32 range is one turn.
+         * Wraparound is free, so no normalisation is ever needed.
+         * Base implementation uses the values returned by update().
+         */
+        virtual uint32_t getMechanicalAngleTurns();
+
+        /**
+         * Get current position as a binary angle including full rotations:
+         * upper 32 bits are the full rotations, lower 32 bits the shaft angle.
+         * The position is exact at any number of rotations.
+         * Base implementation uses the values returned by update().
+         */
+        virtual int64_t getPreciseAngleTurns();
+
+        /**
+         * Time [us] since the physical sample of the current angle, the latency of the angle.
+         * Base implementation uses the values returned by update().
+         */
+        uint32_t getAngleAge();
+
         /** 
          * Get current angular velocity (rad/s)
          * Can be overridden in subclasses. Base implementation uses the values 
@@ -109,6 +132,12 @@ class Sensor{
          */
         float min_elapsed_time = 0.000100; // default is 100 microseconds, or 10kHz
 
+        /**
+         * Nonlinearity correction of the sensor angle, applied in update(). nullptr for none.
+         * Fit it with the correction unlinked, the sweep needs the raw angles.
+         */
+        SensorCalibration* calibration = nullptr;
+
     protected:
         /** 
          * Get current shaft angle from the sensor hardware, and 
@@ -119,6 +148,23 @@ class Sensor{
          * Use update() when calling from outside code.
          */
         virtual float getSensorAngle()=0;
+        /**
+         * Get current shaft angle from the sensor hardware as a binary angle,
+         * the full uint32 range is one turn, returned in the lower 32 bits.
+         * Negative values signal errors.
+         *
+         * Base implementation converts the getSensorAngle() value, override it in sensors
+         * that read a raw count to skip the float conversion.
+         */
+        virtual int64_t getSensorAngleTurns();
+        /**
+         * Time [us] from the physical sample of the angle last returned by getSensorAngleTurns() to now.
+         * update() dates the angle back by it, so the velocity and the latency compensation use the sample time.
+         *
+         * Base implementation returns 0 (angle read on the spot), override it in sensors
+         * reading in the background or taking long to read.
+         */
+        virtual uint32_t getSensorAngleAge();
         /**
          * Call Sensor::init() from your sensor subclass's init method if you want smoother startup
          * The base class init() method calls getSensorAngle() several times to initialize the internal fields
@@ -130,8 +176,10 @@ class Sensor{
         // velocity calculation variables
         float velocity=0.0f;
         float angle_prev=0.0f; // result of last call to getSensorAngle(), used for full rotations and velocity
+        uint32_t angle_prev_turns=0; // angle_prev as a binary angle
         long angle_prev_ts=0; // timestamp of last call to getAngle, used for velocity
         float vel_angle_prev=0.0f; // angle at last call to getVelocity, used for velocity
+        uint32_t vel_angle_prev_turns=0; // vel_angle_prev as a binary angle
         long vel_angle_prev_ts=0; // last velocity calculation timestamp
         int32_t full_rotations=0; // full rotation tracking
         int32_t vel_full_rotations=0; // previous full rotation value for velocity calculation
@@ -2,6 +2,7 @@
 #define STEPPERDRIVER_H
 
 #include "FOCDriver.h"
+#include "../fixed_point.h"
 
 class StepperDriver: public FOCDriver{
     public:
@@ -14,6 +15,15 @@ class StepperDriver: public FOCDriver{
         */
         virtual void setPwm(float Ua, float Ub) = 0;
 
+        /** 
+         * Set phase voltages to the hardware, fixed point variant used by the
+         * fixed point FOC pipeline. Default implementation falls back to setPwm().
+         * 
+         * @param Ua phase A voltage in Q16.16
+         * @param Ub phase B voltage in Q16.16
+        */
+        virtual void setPwmQ16(q16_t Ua, q16_t Ub) { setPwm(_q16_to_float(Ua), _q16_to_float(Ub)); };
+
         /**
          * Set phase state, enable/disable
          *
@@ -21,6 +31,9 @@ class StepperDriver: public FOCDriver{
          * @param sb - phase B state : active / disabled ( high impedance )
         */
         virtual void setPhaseState(PhaseState sa, PhaseState sb) = 0;
+
+        int8_t polarity_a = 1; //!< polarity of the last phase A voltage, the bridge current is driven in this direction
+        int8_t polarity_b = 1; //!< polarity of the last phase B voltage, the bridge current is driven in this direction
         
         /** driver type getter function */
         virtual DriverType type() override { return DriverType::Stepper; } ;
@@ -0,0 +1,42 @@
+#ifndef VELOCITYESTIMATOR_H
+#define VELOCITYESTIMATOR_H
+
+#include "../foc_utils.h"
+
+/**
+ * Velocity estimator interface
+ *
+ * Estimates the shaft velocity from the exact multi-turn angle of the sensor,
+ * as an alternative to differentiating two angle samples in Sensor::getVelocity() and
+ * low pass filtering the result. Linked to a motor with FOCMotor::linkVelocityEstimator(),
+ * it is updated after every sensor update in loopFOC() and replaces the filtered
+ * sensor velocity in shaftVelocity().
+ */
+class VelocityEstimator
+{
+  public:
+    virtual ~VelocityEstimator() = default;
+
+    /**
+     * Update the estimate with a new angle sample
+     * @param angle - multi-turn angle as a binary angle, 2^32 per turn (Sensor::getPreciseAngleTurns())
+     * @param Ts - time since the previous sample [s]
+     * @returns the velocity estimate [rad/s]
+     */
+    virtual float update(int64_t angle, float Ts) = 0;
+    /**
+     * Restart the estimate at standstill
+     * @param angle - current multi-turn angle as a binary angle
+     */
+    virtual void reset(int64_t angle) = 0;
+    /**
+     * Acceleration not explained by acceleration_input [rad/s^2],
+     * only estimated by the model based estimators
+     */
+    virtual float disturbance() { return 0.0f; }
+
+    float velocity = 0.0f; //!< last velocity estimate [rad/s]
+    float acceleration_input = 0.0f; //!< modelled acceleration of the shaft [rad/s^2], electromagnetic torque / inertia
+};
+
+#endif
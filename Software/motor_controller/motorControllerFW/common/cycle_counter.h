@@ -0,0 +1,32 @@
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include <stdint.h>
+#include "hardware/structs/systick.h"
+
+// Cycle accurate time measurement with the SysTick timer of the calling core
+// SysTick is a 24 bit down counter on the processor clock, so intervals up to 2^24 cycles
+// (134ms at 125MHz) are measured correctly. Each core has its own SysTick.
+
+#define _CYCLE_COUNTER_MASK 0x00FFFFFF
+
+/** start SysTick free running on the processor clock, without interrupt */
+static inline void _cycleCounterInit() {
+    if ((systick_hw->csr & 0x5) == 0x5 && systick_hw->rvr == _CYCLE_COUNTER_MASK) return; // already running
+    systick_hw->csr = 0;
+    systick_hw->rvr = _CYCLE_COUNTER_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // CLKSOURCE = processor clock, ENABLE
+}
+
+/** current counter value, only meaningful as the start of an interval */
+static inline uint32_t _cycles() {
+    return systick_hw->cvr;
+}
+
+/** cycles elapsed since start */
+static inline uint32_t _cyclesSince(uint32_t start) {
+    return (start - systick_hw->cvr) & _CYCLE_COUNTER_MASK;
+}
+
+#endif
@@ -44,6 +44,10 @@
 #define DEF_VOLTAGE_SENSOR_ALIGN 3.0f //!< default voltage for sensor and motor zero alignemt
 // low pass filter velocity
 #define DEF_VEL_FILTER_Tf 0.005f //!< default velocity filter time constant
+// angle latency compensation
+#define DEF_ANGLE_LATENCY_MAX 0.002f //!< longest latency [s] the electrical angle is extrapolated over
 
 // current sense default parameters
-#define DEF_LPF_PER_PHASE_CURRENT_SENSE_Tf 0.0f  //!< default currnet sense per phase low pass filter time constant 
\ No newline at end of file
+#define DEF_LPF_PER_PHASE_CURRENT_SENSE_Tf 0.0f  //!< default currnet sense per phase low pass filter time constant
+#define DEF_VBUS_FILTER_Tf 0.002f //!< default bus voltage filter time constant
+#define DEF_VBUS_COMPENSATION_MIN 5.0f //!< bus voltages below this are not used for the duty cycle (supply off or no measurement) 
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Compile time selection of the fixed point FOC pipeline
+// The RP2040 has no FPU, so with this enabled the hot path (sine/cosine, inverse Park,
+// PWM duty cycles, PID controllers and low pass filters) runs on integer arithmetic.
+// The float interfaces of all the classes stay the same. The current loop of the stepper keeps
+// Q16.16 from the ADC read through the filters, PI controllers and inverse Park to the PWM duty
+// (stepQ16, filterQ16, getPhaseCurrentsQ16, setPhaseVoltageTurnsQ16); only the motion rate
+// operands and the monitoring copies are converted, and only when their bit patterns change.
+// The cycles of both versions are printed at boot by printFixedPointTiming(), the equivalence
+// with the float path is checked on the host by host/pid_fixed_bench.
+#ifndef SIMPLEFOC_FIXED_POINT
+#define SIMPLEFOC_FIXED_POINT 0
+#endif
+
+// fixed point formats
+typedef int16_t q15_t; //!< [-1, 1) with 15 fractional bits - sine, cosine
+typedef int32_t q16_t; //!< [-32768, 32768) with 16 fractional bits - volts, amps, rad, rad/s
+
+#define _Q15_ONE 32768
+#define _Q16_ONE 65536
+#define _Q16_MAX INT32_MAX
+#define _Q16_MIN (-INT32_MAX)
+#define _Q16_FLOAT_LIMIT 32767.0f
+
+// radians to 16 bit binary angle (2^16 per turn)
+#define _RAD_TO_TURNS16 10430.3783505f
+// 16 bit binary angle to radians
+#define _TURNS16_TO_RAD 0.0000958737992f
+// radians to 32 bit binary angle (2^32 per turn)
+#define _RAD_TO_TURNS32 683565275.576f
+// 32 bit binary angle to radians
+#define _TURNS32_TO_RAD 0.00000000146291808f
+
+// current structures of the fixed point pipeline, as DQCurrent_s and PhaseCurrent_s
+struct DQCurrentQ16_s { q16_t d; q16_t q; };
+struct PhaseCurrentQ16_s { q16_t a; q16_t b; q16_t c; };
+
+/** saturate a 64 bit intermediate into the Q16.16 range */
+static inline q16_t _q16_sat(int64_t x) {
+  return (x > _Q16_MAX) ? _Q16_MAX : ( (x < _Q16_MIN) ? _Q16_MIN : (q16_t)x );
+}
+
+/** float to Q16.16 conversion, saturating and rounding - truncation would bias the integrators */
+static inline q16_t _float_to_q16(float x) {
+  if (x >= _Q16_FLOAT_LIMIT) return _Q16_MAX;
+  if (x <= -_Q16_FLOAT_LIMIT) return _Q16_MIN;
+  return (q16_t)(x * 65536.0f + (x < 0.0f ? -0.5f : 0.5f));
+}
+
+/** bit pattern of a float - change detection of the public float parameters with an integer
+ *  compare, a float compare is a soft-float call on the RP2040 */
+static inline uint32_t _float_bits(float x) {
+  uint32_t b;
+  memcpy(&b, &x, sizeof(b));
+  return b;
+}
+
+/** Q16.16 to float conversion */
+static inline float _q16_to_float(q16_t x) {
+  return (float)x * (1.0f/65536.0f);
+}
+
+/** Q16.16 x Q16.16 multiplication */
+static inline q16_t _q16_mul(q16_t a, q16_t b) {
+  return _q16_sat( ((int64_t)a * b) >> 16 );
+}
+
+/** Q16.16 x Q15 multiplication - scaling a physical value by a sine/cosine */
+static inline q16_t _q16_mul_q15(q16_t a, q15_t b) {
+  return (q16_t)( ((int64_t)a * b) >> 15 );
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include "fixed_point_bench.h"
+#include "foc_utils.h"
+#include "defaults.h"
+#include "cycle_counter.h"
+#include "hardware/clocks.h"
+
+// both arithmetics side by side, independent of SIMPLEFOC_FIXED_POINT of the build
+// (the system headers are included above, the headers of the two copies only declare the classes)
+#pragma push_macro("SIMPLEFOC_FIXED_POINT")
+#undef SIMPLEFOC_FIXED_POINT
+#define SIMPLEFOC_FIXED_POINT 0
+#undef PID_H
+#undef LOWPASS_FILTER_H
+namespace bench_float {
+#include "pid.cpp"
+#include "lowpass_filter.cpp"
+}
+#undef SIMPLEFOC_FIXED_POINT
+#define SIMPLEFOC_FIXED_POINT 1
+#undef PID_H
+#undef LOWPASS_FILTER_H
+namespace bench_fixed {
+#include "pid.cpp"
+#include "lowpass_filter.cpp"
+}
+#pragma pop_macro("SIMPLEFOC_FIXED_POINT")
+
+#define BENCH_CALLS 256
+#define BENCH_TS 5e-4f
+
+// error inputs spread over +-2A
+static float bench_input(int i) {
+  return ((i * 37) % 64 - 32) * (2.0f / 32.0f);
+}
+
+void printFixedPointTiming() {
+  float inputs[BENCH_CALLS];
+  q16_t inputs_q[BENCH_CALLS];
+  for (int i = 0; i < BENCH_CALLS; i++) {
+    inputs[i] = bench_input(i);
+    inputs_q[i] = _float_to_q16(inputs[i]);
+  }
+  volatile float sink = 0.0f;
+  volatile q16_t sink_q = 0;
+  _cycleCounterInit();
+
+  bench_float::PIDController pid_f(DEF_PID_CURR_P, DEF_PID_CURR_I, 0, DEF_PID_CURR_RAMP, DEF_POWER_SUPPLY);
+  bench_fixed::PIDController pid_q(DEF_PID_CURR_P, DEF_PID_CURR_I, 0, DEF_PID_CURR_RAMP, DEF_POWER_SUPPLY);
+  bench_float::LowPassFilter lpf_f(DEF_CURR_FILTER_Tf);
+  bench_fixed::LowPassFilter lpf_q(DEF_CURR_FILTER_Tf);
+  pid_f.setSampleTime(BENCH_TS);
+  pid_q.setSampleTime(BENCH_TS);
+  lpf_f.setSampleTime(BENCH_TS);
+  lpf_q.setSampleTime(BENCH_TS);
+
+  uint32_t start = _cycles();
+  for (int i = 0; i < BENCH_CALLS; i++) sink = pid_f(inputs[i]);
+  uint32_t pid_float = _cyclesSince(start) / BENCH_CALLS;
+  start = _cycles();
+  for (int i = 0; i < BENCH_CALLS; i++) sink = pid_q(inputs[i]);
+  uint32_t pid_fixed = _cyclesSince(start) / BENCH_CALLS;
+  start = _cycles();
+  for (int i = 0; i < BENCH_CALLS; i++) sink_q = pid_q.stepQ16(inputs_q[i]);
+  uint32_t pid_q16 = _cyclesSince(start) / BENCH_CALLS;
+
+  start = _cycles();
+  for (int i = 0; i < BENCH_CALLS; i++) sink = lpf_f(inputs[i]);
+  uint32_t lpf_float = _cyclesSince(start) / BENCH_CALLS;
+  start = _cycles();
+  for (int i = 0; i < BENCH_CALLS; i++) sink = lpf_q(inputs[i]);
+  uint32_t lpf_fixed = _cyclesSince(start) / BENCH_CALLS;
+  start = _cycles();
+  for (int i = 0; i < BENCH_CALLS; i++) sink_q = lpf_q.filterQ16(inputs_q[i]);
+  uint32_t lpf_q16 = _cyclesSince(start) / BENCH_CALLS;
+
+  // current loop arithmetic of loopFOC: Park, filters, PI controllers, inverse Park
+  bench_float::PIDController pid_fd(DEF_PID_CURR_P, DEF_PID_CURR_I, 0, DEF_PID_CURR_RAMP, DEF_POWER_SUPPLY);
+  bench_fixed::PIDController pid_qd(DEF_PID_CURR_P, DEF_PID_CURR_I, 0, DEF_PID_CURR_RAMP, DEF_POWER_SUPPLY);
+  bench_float::LowPassFilter lpf_fd(DEF_CURR_FILTER_Tf);
+  bench_fixed::LowPassFilter lpf_qd(DEF_CURR_FILTER_Tf);
+  pid_fd.setSampleTime(BENCH_TS);
+  pid_qd.setSampleTime(BENCH_TS);
+  lpf_fd.setSampleTime(BENCH_TS);
+  lpf_qd.setSampleTime(BENCH_TS);
+
+  start = _cycles();
+  for (int i = 0; i < BENCH_CALLS; i++) {
+    float a = i * (_2PI / BENCH_CALLS), s, c;
+    _sincos(a, &s, &c);
+    float ia = inputs[i], ib = inputs[(i + 64) % BENCH_CALLS];
+    float id = lpf_fd(ia * c + ib * s);
+    float iq = lpf_f(ib * c - ia * s);
+    float ud = pid_fd(0.0f - id);
+    float uq = pid_f(0.5f - iq);
+    sink = (c * ud - s * uq) + (s * ud + c * uq);
+  }
+  uint32_t loop_float = _cyclesSince(start) / BENCH_CALLS;
+
+  start = _cycles();
+  for (int i = 0; i < BENCH_CALLS; i++) {
+    q15_t s, c;
+    _sincos_q15((uint32_t)i << 24, &s, &c);
+    q16_t ia = inputs_q[i], ib = inputs_q[(i + 64) % BENCH_CALLS];
+    q16_t id = lpf_qd.filterQ16(_q16_mul_q15(ia, c) + _q16_mul_q15(ib, s));
+    q16_t iq = lpf_q.filterQ16(_q16_mul_q15(ib, c) - _q16_mul_q15(ia, s));
+    q16_t ud = pid_qd.stepQ16(-id);
+    q16_t uq = pid_q.stepQ16(_Q16_ONE / 2 - iq);
+    sink_q = (_q16_mul_q15(ud, c) - _q16_mul_q15(uq, s)) + (_q16_mul_q15(ud, s) + _q16_mul_q15(uq, c));
+  }
+  uint32_t loop_q16 = _cyclesSince(start) / BENCH_CALLS;
+
+  printf("Fixed point cycles per call (%s build): PID float %lu, fixed %lu, Q16 %lu | LPF float %lu, fixed %lu, Q16 %lu\n",
+         SIMPLEFOC_FIXED_POINT ? "fixed point" : "float",
+         (unsigned long)pid_float, (unsigned long)pid_fixed, (unsigned long)pid_q16,
+         (unsigned long)lpf_float, (unsigned long)lpf_fixed, (unsigned long)lpf_q16);
+  printf("Current loop arithmetic cycles per step: float %lu, Q16 %lu (%.2f / %.2f us)\n",
+         (unsigned long)loop_float, (unsigned long)loop_q16,
+         loop_float * 1e6f / clock_get_hz(clk_sys), loop_q16 * 1e6f / clock_get_hz(clk_sys));
+}
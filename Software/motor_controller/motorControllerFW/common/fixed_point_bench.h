@@ -0,0 +1,15 @@
+#ifndef FIXED_POINT_BENCH_H
+#define FIXED_POINT_BENCH_H
+
+/**
+ * On target cycle comparison of the float and the SIMPLEFOC_FIXED_POINT controllers
+ * Both versions of PIDController and LowPassFilter are compiled into fixed_point_bench.cpp, whatever the build,
+ * and timed with the SysTick cycle counter of the calling core:
+ *  - PID and low pass filter steps: float, fixed point through the float interface, fixed point on Q16.16
+ *  - the current loop arithmetic of loopFOC (2 filters, 2 PI controllers, Park and inverse Park),
+ *    float against Q16.16 end to end - without the ADC read and the PWM write, which both versions share
+ * Prints the cycles per call, takes a few ms - call it before the scheduler is started.
+ */
+void printFixedPointTiming();
+
+#endif
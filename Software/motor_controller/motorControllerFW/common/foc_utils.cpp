@@ -1,14 +1,15 @@
 #include "foc_utils.h"
 
 
+// 16bit integer array for sine lookup. interpolation is used for better precision
+// 16 bit precision on sine value, 8 bit fractional value for interpolation, 6bit LUT size
+// resulting precision compared to stdlib sine is 0.00006480 (RMS difference in range -PI,PI for 3217 steps)
+static const uint16_t sine_array[65] = {0,804,1608,2411,3212,4011,4808,5602,6393,7180,7962,8740,9512,10279,11039,11793,12540,13279,14010,14733,15447,16151,16846,17531,18205,18868,19520,20160,20788,21403,22006,22595,23170,23732,24279,24812,25330,25833,26320,26791,27246,27684,28106,28511,28899,29269,29622,29957,30274,30572,30853,31114,31357,31581,31786,31972,32138,32286,32413,32522,32610,32679,32729,32758,32768};
+
 // function approximating the sine calculation by using fixed size array
 // uses a 65 element lookup table and interpolation
 // thanks to @dekutree for his work on optimizing this
 __attribute__((weak)) float _sin(float a){
-  // 16bit integer array for sine lookup. interpolation is used for better precision
-  // 16 bit precision on sine value, 8 bit fractional value for interpolation, 6bit LUT size
-  // resulting precision compared to stdlib sine is 0.00006480 (RMS difference in range -PI,PI for 3217 steps)
-  static uint16_t sine_array[65] = {0,804,1608,2411,3212,4011,4808,5602,6393,7180,7962,8740,9512,10279,11039,11793,12540,13279,14010,14733,15447,16151,16846,17531,18205,18868,19520,20160,20788,21403,22006,22595,23170,23732,24279,24812,25330,25833,26320,26791,27246,27684,28106,28511,28899,29269,29622,29957,30274,30572,30853,31114,31357,31581,31786,31972,32138,32286,32413,32522,32610,32679,32729,32758,32768};
   int32_t t1, t2;
   unsigned int i = (unsigned int)(a * (64*4*256.0f/_2PI));
   int frac = i & 0xff;
@@ -40,9 +41,42 @@ __attribute__((weak)) float _cos(float a){
 }
 
 
+// table value for a full-turn index 0..255 - folds the quarter wave table into four quadrants
+static inline int32_t _sine_lookup(unsigned int i){
+  i &= 0xff;
+  if (i <= 64) return (int32_t)sine_array[i];
+  else if(i <= 128) return (int32_t)sine_array[128 - i];
+  else if(i <= 192) return -(int32_t)sine_array[i - 128];
+  else return -(int32_t)sine_array[256 - i];
+}
+
+// sine and cosine from a single index/fraction computation
+// the cosine is the sine table read 64 entries (+90deg) further, with the same fraction
 __attribute__((weak)) void _sincos(float a, float* s, float* c){
-  *s = _sin(a);
-  *c = _cos(a);
+  unsigned int i = (unsigned int)(int32_t)(a * (64*4*256.0f/_2PI));
+  int32_t frac = i & 0xff;
+  i = i >> 8;
+  int32_t s1 = _sine_lookup(i), s2 = _sine_lookup(i + 1);
+  int32_t c1 = _sine_lookup(i + 64), c2 = _sine_lookup(i + 65);
+  *s = (1.0f/32768.0f) * (s1 + (((s2 - s1) * frac) >> 8));
+  *c = (1.0f/32768.0f) * (c1 + (((c2 - c1) * frac) >> 8));
+}
+
+// sine of a 16 bit binary angle (8 bit table index, 8 bit interpolation fraction) in Q15
+// same table walk as _sincos, without the float multiply to find the index
+static inline int32_t _sin_q15(uint32_t a16){
+  unsigned int i = (a16 >> 8) & 0xff;
+  int32_t frac = a16 & 0xff;
+  int32_t t1 = _sine_lookup(i), t2 = _sine_lookup(i + 1);
+  int32_t v = t1 + (((t2 - t1) * frac) >> 8);
+  // the table peaks at 32768 which does not fit Q15
+  return v > 32767 ? 32767 : v;
+}
+
+__attribute__((weak)) void _sincos_q15(uint32_t angle, q15_t* s, q15_t* c){
+  uint32_t a16 = angle >> 16;
+  *s = (q15_t)_sin_q15(a16);
+  *c = (q15_t)_sin_q15(a16 + 0x4000); // +90deg, wraps for free
 }
 
 // fast_atan2 based on https://math.stackexchange.com/a/1105038/81278
@@ -1,11 +1,19 @@
 #ifndef FOCUTILS_LIB_H
 #define FOCUTILS_LIB_H
 
+#ifndef SIMPLEFOC_HOST_BUILD
 #include "RP2040.h"
 #include "pico/stdlib.h"
+#else
+// host build (host/ tools) - no pico SDK, only the portable math
+#include <stdint.h>
+// microsecond clock, provided by the host tool
+uint64_t time_us_64();
+#endif
 #include "math.h"
 #include <stdio.h>
 #include <string.h>
+#include "fixed_point.h"
 
 // sign function
 #define _sign(a) ( ( (a) < 0 )  ?  -1   : ( (a) > 0 ) )
@@ -86,11 +94,21 @@ float _sin(float a);
 float _cos(float a);
 /**
  * Function returning both sine and cosine of the angle in one call.
- * Internally it uses the _sin and _cos functions, but you may wish to
- * provide your own implementation which is more optimized.
+ * The table index and interpolation fraction are computed once and used for both outputs.
+ * On the RP2040 it is overridden by an SIO interpolator based version (foc_utils_rp2040.cpp).
  */
 void _sincos(float a, float* s, float* c);
 
+/**
+ * Fixed point sine and cosine of a binary angle, using the same lookup table as _sin
+ * - wraparound is free, the full 32 bit range is one electrical turn
+ *
+ * @param angle binary angle, 2^32 is one full turn (only the upper 16 bits are used)
+ * @param s sine output in Q15
+ * @param c cosine output in Q15
+ */
+void _sincos_q15(uint32_t angle, q15_t* s, q15_t* c);
+
 /**
  * Function approximating atan2 
  * 
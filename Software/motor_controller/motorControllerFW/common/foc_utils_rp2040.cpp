@@ -0,0 +1,63 @@
+#include "foc_utils.h"
+#include "hardware/interp.h"
+#include "hardware/sync.h"
+
+// RP2040 specific overrides of the weak functions in foc_utils.cpp
+// The table index and interpolation fraction are split out of the angle by the SIO interpolator,
+// so the only software work left is the float scaling and one multiply per output.
+// interp1 is reserved for these functions, it is configured on the first call on each core.
+
+// full turn sine table, 256 entries per turn plus a quarter turn and one entry so that
+// cos = the same pointer + 64 and the interpolation neighbour never needs a wraparound
+// same values as the quarter wave sine_array in foc_utils.cpp, with the peak clipped to fit int16
+static const int16_t sine_table_full[321] = {0,804,1608,2411,3212,4011,4808,5602,6393,7180,7962,8740,9512,10279,11039,11793,12540,13279,14010,14733,15447,16151,16846,17531,18205,18868,19520,20160,20788,21403,22006,22595,23170,23732,24279,24812,25330,25833,26320,26791,27246,27684,28106,28511,28899,29269,29622,29957,30274,30572,30853,31114,31357,31581,31786,31972,32138,32286,32413,32522,32610,32679,32729,32758,32767,32758,32729,32679,32610,32522,32413,32286,32138,31972,31786,31581,31357,31114,30853,30572,30274,29957,29622,29269,28899,28511,28106,27684,27246,26791,26320,25833,25330,24812,24279,23732,23170,22595,22006,21403,20788,20160,19520,18868,18205,17531,16846,16151,15447,14733,14010,13279,12540,11793,11039,10279,9512,8740,7962,7180,6393,5602,4808,4011,3212,2411,1608,804,0,-804,-1608,-2411,-3212,-4011,-4808,-5602,-6393,-7180,-7962,-8740,-9512,-10279,-11039,-11793,-12540,-13279,-14010,-14733,-15447,-16151,-16846,-17531,-18205,-18868,-19520,-20160,-20788,-21403,-22006,-22595,-23170,-23732,-24279,-24812,-25330,-25833,-26320,-26791,-27246,-27684,-28106,-28511,-28899,-29269,-29622,-29957,-30274,-30572,-30853,-31114,-31357,-31581,-31786,-31972,-32138,-32286,-32413,-32522,-32610,-32679,-32729,-32758,-32768,-32758,-32729,-32679,-32610,-32522,-32413,-32286,-32138,-31972,-31786,-31581,-31357,-31114,-30853,-30572,-30274,-29957,-29622,-29269,-28899,-28511,-28106,-27684,-27246,-26791,-26320,-25833,-25330,-24812,-24279,-23732,-23170,-22595,-22006,-21403,-20788,-20160,-19520,-18868,-18205,-17531,-16846,-16151,-15447,-14733,-14010,-13279,-12540,-11793,-11039,-10279,-9512,-8740,-7962,-7180,-6393,-5602,-4808,-4011,-3212,-2411,-1608,-804,0,804,1608,2411,3212,4011,4808,5602,6393,7180,7962,8740,9512,10279,11039,11793,12540,13279,14010,14733,15447,16151,16846,17531,18205,18868,19520,20160,20788,21403,22006,22595,23170,23732,24279,24812,25330,25833,26320,26791,27246,27684,28106,28511,28899,29269,29622,29957,30274,30572,30853,31114,31357,31581,31786,31972,32138,32286,32413,32522,32610,32679,32729,32758,32767};
+
+// interp1 configuration, done once per core (each core has its own interpolators)
+// lane 0: (a16 >> 7) & 0x1fe + table base = address of the int16 entry for the upper 8 bits
+// lane 1: a16 & 0xff = interpolation fraction, reading the accumulator of lane 0
+static bool interp_configured[2] = {false, false};
+
+static void _sincos_interp_init(){
+  interp_config cfg = interp_default_config();
+  interp_config_set_shift(&cfg, 7);
+  interp_config_set_mask(&cfg, 1, 8);
+  interp_set_config(interp1, 0, &cfg);
+  cfg = interp_default_config();
+  interp_config_set_cross_input(&cfg, true);
+  interp_config_set_mask(&cfg, 0, 7);
+  interp_set_config(interp1, 1, &cfg);
+  interp1->base[0] = (uintptr_t)sine_table_full;
+  interp1->base[1] = 0;
+  interp_configured[get_core_num()] = true;
+}
+
+// load a 16 bit binary angle into interp1 and return the table pointer and the fraction
+// the interrupts are disabled only around the accumulator write and the two reads,
+// so an interrupt handler on this core can not load its own angle halfway through
+static inline const int16_t* _sincos_interp(uint32_t a16, int32_t* frac){
+  if(!interp_configured[get_core_num()]) _sincos_interp_init();
+  uint32_t irq_state = save_and_disable_interrupts();
+  interp1->accum[0] = a16;
+  *frac = (int32_t)interp1->peek[1];
+  const int16_t* p = (const int16_t*)(uintptr_t)interp1->peek[0];
+  restore_interrupts(irq_state);
+  return p;
+}
+
+void _sincos(float a, float* s, float* c){
+  int32_t frac;
+  const int16_t* p = _sincos_interp((uint32_t)(int32_t)(a * (64*4*256.0f/_2PI)), &frac);
+  int32_t s1 = p[0], s2 = p[1];
+  int32_t c1 = p[64], c2 = p[65];
+  *s = (1.0f/32768.0f) * (s1 + (((s2 - s1) * frac) >> 8));
+  *c = (1.0f/32768.0f) * (c1 + (((c2 - c1) * frac) >> 8));
+}
+
+void _sincos_q15(uint32_t angle, q15_t* s, q15_t* c){
+  int32_t frac;
+  const int16_t* p = _sincos_interp(angle >> 16, &frac);
+  int32_t s1 = p[0], s2 = p[1];
+  int32_t c1 = p[64], c2 = p[65];
+  *s = (q15_t)(s1 + (((s2 - s1) * frac) >> 8));
+  *c = (q15_t)(c1 + (((c2 - c1) * frac) >> 8));
+}
@@ -0,0 +1,47 @@
+#include "load_torque_observer.h"
+
+LoadTorqueObserver::LoadTorqueObserver(float _bandwidth)
+    : bandwidth(_bandwidth)
+{
+}
+
+float LoadTorqueObserver::update(int64_t angle, float Ts)
+{
+    if(bandwidth != bandwidth_cache) updateGains();
+    // first sample or strange sample time - restart from the measured angle
+    if(!initialized || Ts <= 0.0f || Ts > 0.5f) {
+        reset(angle);
+        return velocity;
+    }
+    // predict with the model
+    angle_est += (int64_t)(velocity*Ts*_RAD_TO_TURNS32);
+    velocity += (acceleration_input + disturbance_est)*Ts;
+    // measurement error - exact in binary angles
+    float err = (float)(angle - angle_est) * _TURNS32_TO_RAD;
+    // correct
+    angle_est += (int64_t)(L1*Ts*err*_RAD_TO_TURNS32);
+    velocity += L2*Ts*err;
+    disturbance_est += L3*Ts*err;
+    return velocity;
+}
+
+void LoadTorqueObserver::reset(int64_t angle)
+{
+    angle_est = angle;
+    velocity = 0.0f;
+    disturbance_est = 0.0f;
+    initialized = true;
+}
+
+float LoadTorqueObserver::disturbance()
+{
+    return disturbance_est;
+}
+
+void LoadTorqueObserver::updateGains()
+{
+    bandwidth_cache = bandwidth;
+    L1 = 3.0f*bandwidth;
+    L2 = 3.0f*bandwidth*bandwidth;
+    L3 = bandwidth*bandwidth*bandwidth;
+}
@@ -0,0 +1,50 @@
+#ifndef LOAD_TORQUE_OBSERVER_H
+#define LOAD_TORQUE_OBSERVER_H
+
+#include "base_classes/VelocityEstimator.h"
+
+/**
+ * Luenberger observer of angle, velocity and load torque
+ *
+ * Model of the shaft, with the load as an unknown constant disturbance acceleration d:
+ *   angle' = velocity
+ *   velocity' = acceleration_input + d
+ *   d' = 0
+ * acceleration_input is the electromagnetic torque divided by the inertia, provided by the motor.
+ * The observer is corrected with the error to the measured angle, the gains place
+ * all three poles at -bandwidth:
+ *   L1 = 3*bandwidth, L2 = 3*bandwidth^2, L3 = bandwidth^3
+ * which is the steady state Kalman gain for a suitable ratio of process to measurement noise,
+ * without the covariance update in the loop.
+ *
+ * The load torque is -inertia*disturbance(). Without a model input the observer still tracks
+ * constant accelerations without lag, the whole acceleration is then seen as disturbance.
+ */
+class LoadTorqueObserver : public VelocityEstimator
+{
+  public:
+    /**
+     * @param bandwidth - observer bandwidth [rad/s]
+     */
+    LoadTorqueObserver(float bandwidth);
+
+    float update(int64_t angle, float Ts) override;
+    void reset(int64_t angle) override;
+    float disturbance() override;
+
+    float bandwidth; //!< observer bandwidth [rad/s]
+
+  protected:
+    /** refresh the observer gains if the bandwidth changed */
+    void updateGains();
+
+    float bandwidth_cache = 0.0f; //!< bandwidth the gains were computed from
+    float L1 = 0.0f; //!< angle correction gain [1/s]
+    float L2 = 0.0f; //!< velocity correction gain [1/s^2]
+    float L3 = 0.0f; //!< disturbance correction gain [1/s^3]
+    int64_t angle_est = 0; //!< estimated multi-turn angle, 2^32 per turn
+    float disturbance_est = 0.0f; //!< estimated disturbance acceleration [rad/s^2]
+    bool initialized = false; //!< estimate started from a measured angle
+};
+
+#endif
@@ -10,6 +10,19 @@ LowPassFilter::LowPassFilter(float time_constant)
 
 float LowPassFilter::operator() (float x)
 {
+#if SIMPLEFOC_FIXED_POINT
+    return _q16_to_float(filterQ16(_float_to_q16(x)));
+#else
+    if(sample_time > 0.0f) {
+        if(_float_bits(Tf) != Tf_cache) {
+            Tf_cache = _float_bits(Tf);
+            alpha_Ts = Tf/(Tf + sample_time);
+        }
+        float y = alpha_Ts*y_prev + (1.0f - alpha_Ts)*x;
+        y_prev = y;
+        return y;
+    }
+
     unsigned long timestamp = time_us_64();
     float dt = (timestamp - timestamp_prev)*1e-6f;
 
@@ -25,4 +38,55 @@ float LowPassFilter::operator() (float x)
     y_prev = y;
     timestamp_prev = timestamp;
     return y;
-}
\ No newline at end of file
+#endif
+}
+
+void LowPassFilter::setSampleTime(float Ts)
+{
+    sample_time = (Ts > 0.0f) ? Ts : 0.0f;
+    // back to measuring - start from now instead of the last measured call
+    timestamp_prev = time_us_64();
+    Tf_cache = _float_bits(Tf);
+#if SIMPLEFOC_FIXED_POINT
+    Tf_us = (Tf > 0.0f) ? (uint32_t)(Tf*1e6f) : 0;
+    sample_time_us = (uint32_t)(sample_time*1e6f + 0.5f);
+    if(sample_time_us) alpha_q = alpha(sample_time_us);
+#else
+    if(sample_time > 0.0f) alpha_Ts = Tf/(Tf + sample_time);
+#endif
+}
+
+#if SIMPLEFOC_FIXED_POINT
+q16_t LowPassFilter::filterQ16(q16_t x_q)
+{
+    if(_float_bits(Tf) != Tf_cache){
+        Tf_cache = _float_bits(Tf);
+        Tf_us = (Tf > 0.0f) ? (uint32_t)(Tf*1e6f) : 0;
+        if(sample_time_us) alpha_q = alpha(sample_time_us);
+    }
+    int32_t a = alpha_q;
+    if(!sample_time_us) {
+        unsigned long timestamp = time_us_64();
+        uint32_t dt_us = timestamp - timestamp_prev;
+        timestamp_prev = timestamp;
+        if(Tf_us == 0 || dt_us > 300000) {
+            y_prev_q = x_q;
+            return x_q;
+        }
+        a = alpha(dt_us);
+    }
+    // y = alpha*y_prev + (1 - alpha)*x
+    q16_t y = _q16_sat( x_q + (((int64_t)a * ((int64_t)y_prev_q - x_q)) >> 15) );
+    y_prev_q = y;
+    return y;
+}
+
+int32_t LowPassFilter::alpha(uint32_t dt_us)
+{
+    if(Tf_us == 0) return 0;
+    // scaled down so that one 32 bit hardware divide is enough
+    uint32_t tf = Tf_us;
+    while(tf >= (1u << 16)) { tf >>= 1; dt_us >>= 1; }
+    return (int32_t)((tf << 15) / (tf + dt_us));
+}
+#endif
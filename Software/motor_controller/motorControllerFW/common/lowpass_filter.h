@@ -17,11 +17,42 @@ public:
     ~LowPassFilter() = default;
 
     float operator() (float x);
+#if SIMPLEFOC_FIXED_POINT
+    /**
+     * Filter step on Q16.16 values, without the float conversions of operator()
+     * @param x - input in Q16.16
+     * @returns filtered value in Q16.16
+     */
+    q16_t filterQ16(q16_t x);
+#endif
     float Tf; //!< Low pass filter time constant
 
+    /**
+     * Fixed sample time mode for filters called at a constant rate
+     * The time between the calls is not measured anymore and the filter
+     * coefficient is only recomputed when Tf changes.
+     * @param Ts - sample time [s], 0 to go back to measuring the time between calls
+     */
+    void setSampleTime(float Ts);
+
 protected:
     unsigned long timestamp_prev;  //!< Last execution timestamp
     float y_prev; //!< filtered value in previous execution step 
+
+    float sample_time = 0.0f; //!< fixed sample time [s], 0 if measured between calls
+    uint32_t Tf_cache = 0; //!< bit pattern of the time constant the precomputed coefficient was computed from
+
+#if SIMPLEFOC_FIXED_POINT
+    uint32_t Tf_us = 0; //!< time constant in microseconds
+    uint32_t sample_time_us = 0; //!< fixed sample time in microseconds, 0 if measured
+    int32_t alpha_q = 0; //!< Tf/(Tf + Ts) in Q15 at the fixed sample time
+    q16_t y_prev_q = 0; //!< filtered value in previous execution step in Q16.16
+
+    /** alpha = Tf/(Tf + dt) in Q15 */
+    int32_t alpha(uint32_t dt_us);
+#else
+    float alpha_Ts = 0.0f; //!< Tf/(Tf + Ts) at the fixed sample time
+#endif
 };
 
 #endif // LOWPASS_FILTER_H
\ No newline at end of file
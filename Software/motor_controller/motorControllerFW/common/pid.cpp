@@ -13,27 +13,49 @@ PIDController::PIDController(float P, float I, float D, float ramp, float limit)
     timestamp_prev = time_us_64();
 }
 
+// the gains are public floats, compared by their bit patterns - integer compares instead of soft-float ones
+bool PIDController::gainsChanged() const {
+    return (gains_cache[0] ^ _float_bits(P)) | (gains_cache[1] ^ _float_bits(I)) | (gains_cache[2] ^ _float_bits(D))
+         | (gains_cache[3] ^ _float_bits(output_ramp)) | (gains_cache[4] ^ _float_bits(limit));
+}
+
 // PID controller function
 float PIDController::operator() (float error){
-    // calculate the time from the last call
-    unsigned long timestamp_now = time_us_64();
-    float Ts = (timestamp_now - timestamp_prev) * 1e-6f;
-    // quick fix for strange cases (micros overflow)
-    if(Ts <= 0 || Ts > 0.5f) Ts = 1e-3f;
-
+#if SIMPLEFOC_FIXED_POINT
+    return _q16_to_float(stepQ16(_float_to_q16(error)));
+#else
     // u(s) = (P + I/s + Ds)e(s)
-    // Discrete implementations
+    // Discrete implementations with the Ts dependent coefficients
+    // I*Ts/2, D/Ts and output_ramp*Ts
+    float i_ts, d_ts, ramp_ts;
+    if(sample_time > 0.0f){
+        if(gainsChanged()) updateCoefficients();
+        i_ts = I_Ts;
+        d_ts = D_Ts;
+        ramp_ts = ramp_Ts;
+    }else{
+        // calculate the time from the last call
+        unsigned long timestamp_now = time_us_64();
+        float Ts = (timestamp_now - timestamp_prev) * 1e-6f;
+        // quick fix for strange cases (micros overflow)
+        if(Ts <= 0 || Ts > 0.5f) Ts = 1e-3f;
+        timestamp_prev = timestamp_now;
+        i_ts = I*Ts*0.5f;
+        d_ts = D/Ts;
+        ramp_ts = output_ramp*Ts;
+    }
+
     // proportional part
     // u_p  = P *e(k)
     float proportional = P * error;
     // Tustin transform of the integral part
     // u_ik = u_ik_1  + I*Ts/2*(ek + ek_1)
-    float integral = integral_prev + I*Ts*0.5f*(error + error_prev);
+    float integral = integral_prev + i_ts*(error + error_prev);
     // antiwindup - limit the output
     integral = _constrain(integral, -limit, limit);
     // Discrete derivation
     // u_dk = D(ek - ek_1)/Ts
-    float derivative = D*(error - error_prev)/Ts;
+    float derivative = d_ts*(error - error_prev);
 
     // sum all the components
     float output = proportional + integral + derivative;
@@ -43,22 +65,129 @@ float PIDController::operator() (float error){
     // if output ramp defined
     if(output_ramp > 0){
         // limit the acceleration by ramping the output
-        float output_rate = (output - output_prev)/Ts;
-        if (output_rate > output_ramp)
-            output = output_prev + output_ramp*Ts;
-        else if (output_rate < -output_ramp)
-            output = output_prev - output_ramp*Ts;
+        float output_step = output - output_prev;
+        if (output_step > ramp_ts)
+            output = output_prev + ramp_ts;
+        else if (output_step < -ramp_ts)
+            output = output_prev - ramp_ts;
     }
     // saving for the next pass
     integral_prev = integral;
     output_prev = output;
     error_prev = error;
-    timestamp_prev = timestamp_now;
     return output;
+#endif
+}
+
+void PIDController::setSampleTime(float Ts){
+    sample_time = (Ts > 0.0f) ? Ts : 0.0f;
+    // back to measuring - start from now instead of the last measured call
+    timestamp_prev = time_us_64();
+#if SIMPLEFOC_FIXED_POINT
+    sample_time_us = (uint32_t)(sample_time*1e6f + 0.5f);
+    updateFixedGains();
+#else
+    updateCoefficients();
+#endif
 }
 
 void PIDController::reset(){
     integral_prev = 0.0f;
     output_prev = 0.0f;
     error_prev = 0.0f;
-}
\ No newline at end of file
+#if SIMPLEFOC_FIXED_POINT
+    integral_prev_q = 0;
+    output_prev_q = 0;
+    error_prev_q = 0;
+#endif
+}
+
+#if SIMPLEFOC_FIXED_POINT
+q16_t PIDController::stepQ16(q16_t e){
+    if(gainsChanged()) updateFixedGains();
+    if(!sample_time_us){
+        // calculate the time from the last call
+        unsigned long timestamp_now = time_us_64();
+        // sample time stays in integer microseconds
+        uint32_t Ts_us = timestamp_now - timestamp_prev;
+        // quick fix for strange cases (micros overflow)
+        if(Ts_us == 0 || Ts_us > 500000) Ts_us = 1000;
+        timestamp_prev = timestamp_now;
+        updateFixedStep(Ts_us);
+    }
+
+    // proportional part
+    q16_t proportional = _q16_mul(P_q, e);
+    // Tustin transform of the integral part
+    // the integral is accumulated in Q32 so that the truncation does not bias it
+    int64_t integral_acc = integral_prev_q + ((I_Ts_q * ((int64_t)e + error_prev_q)) >> 8);
+    // antiwindup - limit the output
+    integral_acc = _constrain(integral_acc, -((int64_t)limit_q << 16), ((int64_t)limit_q << 16));
+    q16_t integral = (q16_t)(integral_acc >> 16);
+    // Discrete derivation
+    q16_t derivative = 0;
+    if(D_Ts_q) derivative = _q16_sat( ((int64_t)D_Ts_q * ((int64_t)e - error_prev_q)) >> 16 );
+
+    // sum all the components
+    q16_t output = _q16_sat( (int64_t)proportional + integral + derivative );
+    // antiwindup - limit the output variable
+    output = _constrain(output, -limit_q, limit_q);
+
+    // if output ramp defined
+    if(ramp_q > 0){
+        // limit the acceleration by ramping the output
+        if ((int64_t)output - output_prev_q > ramp_step_q)
+            output = output_prev_q + ramp_step_q;
+        else if ((int64_t)output - output_prev_q < -ramp_step_q)
+            output = output_prev_q - ramp_step_q;
+    }
+    // saving for the next pass
+    integral_prev_q = integral_acc;
+    output_prev_q = output;
+    error_prev_q = e;
+    return output;
+}
+
+// the gains are public floats which may be changed at any time,
+// so the fixed point copies are refreshed lazily on the next call
+void PIDController::updateFixedGains(){
+    gains_cache[0] = _float_bits(P);
+    gains_cache[1] = _float_bits(I);
+    gains_cache[2] = _float_bits(D);
+    gains_cache[3] = _float_bits(output_ramp);
+    gains_cache[4] = _float_bits(limit);
+    P_q = _float_to_q16(P);
+    // 64 bit so that the integral gain is not capped - I*0.5e-6 in Q40 passes 2^31 already at I ~ 3.6k
+    // the limit keeps I_q*Ts_us below 2^63 for sample times up to 0.5s (I up to ~1.8e9)
+    I_q = (int64_t)_constrain((double)I*0.5e-6*1099511627776.0, -1.0e15, 1.0e15); // 2^40
+    D_q = (int64_t)_constrain((double)D*16777216.0, -1.0e15, 1.0e15); // 2^24
+    ramp_q = (int32_t)_constrain(output_ramp*256.0f, 0.0f, 2.0e9f);
+    limit_q = _float_to_q16(limit);
+    if(sample_time_us) updateFixedStep(sample_time_us);
+}
+
+void PIDController::updateFixedStep(uint32_t Ts_us){
+    // I_q*Ts_us is I*Ts/2 in Q40, shifted down to Q24 - valid as long as I*Ts < 8
+    I_Ts_q = (I_q * Ts_us) >> 16;
+    // D/Ts: Q24 * 1e6 / us = Q24, down to Q16
+    // the 64 bit division is a library call on the M0+, skipped for the PI controllers
+    D_Ts_q = 0;
+    if(D_q) D_Ts_q = (int32_t)_constrain(((_constrain(D_q, -(1ll << 43), (1ll << 43)) * 1000000) / Ts_us) >> 8, -(1ll << 30), (1ll << 30));
+    // ramp*Ts: Q8 * us * (2^32/1e6) >> 24 = Q16
+    ramp_step_q = _q16_sat( (((int64_t)ramp_q * Ts_us) * 4295) >> 24 );
+}
+#else
+// precomputed Ts dependent coefficients of the fixed sample time mode,
+// refreshed lazily like the gains of the fixed point version
+void PIDController::updateCoefficients(){
+    gains_cache[0] = _float_bits(P);
+    gains_cache[1] = _float_bits(I);
+    gains_cache[2] = _float_bits(D);
+    gains_cache[3] = _float_bits(output_ramp);
+    gains_cache[4] = _float_bits(limit);
+    if(sample_time <= 0.0f) return;
+    I_Ts = I*sample_time*0.5f;
+    D_Ts = D/sample_time;
+    ramp_Ts = output_ramp*sample_time;
+}
+#endif
\ No newline at end of file
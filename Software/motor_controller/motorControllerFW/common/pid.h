@@ -22,6 +22,22 @@ public:
 
     float operator() (float error);
     void reset();
+#if SIMPLEFOC_FIXED_POINT
+    /**
+     * PID step on Q16.16 values, without the float conversions of operator()
+     * @param error - tracking error in Q16.16
+     * @returns controller output in Q16.16
+     */
+    q16_t stepQ16(q16_t error);
+#endif
+
+    /**
+     * Fixed sample time mode for controllers called at a constant rate
+     * The time between the calls is not measured anymore and the Ts dependent
+     * coefficients are only recomputed when the gains change.
+     * @param Ts - sample time [s], 0 to go back to measuring the time between calls
+     */
+    void setSampleTime(float Ts);
 
     float P; //!< Proportional gain 
     float I; //!< Integral gain 
@@ -34,6 +50,38 @@ protected:
     float output_prev;  //!< last pid output value
     float integral_prev; //!< last integral component value
     unsigned long timestamp_prev; //!< Last execution timestamp
+
+    float sample_time = 0.0f; //!< fixed sample time [s], 0 if measured between calls
+    uint32_t gains_cache[5] = {0}; //!< bit patterns of the gains the precomputed coefficients were computed from
+    /** true if any of P, I, D, output_ramp or limit changed since the coefficients were computed */
+    bool gainsChanged() const;
+
+#if SIMPLEFOC_FIXED_POINT
+    /** refresh the fixed point gains if any of P, I, D, output_ramp or limit changed */
+    void updateFixedGains();
+    /** Ts dependent fixed point coefficients */
+    void updateFixedStep(uint32_t Ts_us);
+
+    q16_t P_q = 0; //!< P gain in Q16.16
+    int64_t I_q = 0; //!< I*0.5e-6 in Q40, so that Ts can stay in integer microseconds
+    int64_t D_q = 0; //!< D gain in Q24
+    int32_t ramp_q = 0; //!< output ramp in Q24.8 (units/second)
+    q16_t limit_q = 0; //!< output limit in Q16.16
+    q16_t error_prev_q = 0; //!< last tracking error value in Q16.16
+    q16_t output_prev_q = 0; //!< last pid output value in Q16.16
+    int64_t integral_prev_q = 0; //!< last integral component value in Q32.32
+    uint32_t sample_time_us = 0; //!< fixed sample time in microseconds, 0 if measured
+    int64_t I_Ts_q = 0; //!< I*Ts/2 in Q24
+    int32_t D_Ts_q = 0; //!< D/Ts in Q16.16
+    q16_t ramp_step_q = 0; //!< output_ramp*Ts in Q16.16
+#else
+    /** refresh the fixed sample time coefficients if any of I, D or output_ramp changed */
+    void updateCoefficients();
+
+    float I_Ts = 0.0f; //!< I*Ts/2 at the fixed sample time
+    float D_Ts = 0.0f; //!< D/Ts at the fixed sample time
+    float ramp_Ts = 0.0f; //!< output_ramp*Ts at the fixed sample time
+#endif
 };
 
 #endif // PID_H
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "pll_velocity_estimator.h"
+
+PLLVelocityEstimator::PLLVelocityEstimator(float _bandwidth)
+    : bandwidth(_bandwidth)
+{
+}
+
+float PLLVelocityEstimator::update(int64_t angle, float Ts)
+{
+    if(bandwidth != bandwidth_cache) updateGains();
+    // first sample or strange sample time - restart from the measured angle
+    if(!initialized || Ts <= 0.0f || Ts > 0.5f) {
+        reset(angle);
+        return velocity;
+    }
+    // predict
+    angle_est += (int64_t)(velocity*Ts*_RAD_TO_TURNS32);
+    // phase detector - exact in binary angles
+    float err = (float)(angle - angle_est) * _TURNS32_TO_RAD;
+    // correct
+    angle_est += (int64_t)(kp*Ts*err*_RAD_TO_TURNS32);
+    velocity += ki*Ts*err;
+    return velocity;
+}
+
+void PLLVelocityEstimator::reset(int64_t angle)
+{
+    angle_est = angle;
+    velocity = 0.0f;
+    initialized = true;
+}
+
+void PLLVelocityEstimator::updateGains()
+{
+    bandwidth_cache = bandwidth;
+    kp = 2.0f*bandwidth;
+    ki = bandwidth*bandwidth;
+}
@@ -0,0 +1,42 @@
+#ifndef PLL_VELOCITY_ESTIMATOR_H
+#define PLL_VELOCITY_ESTIMATOR_H
+
+#include "base_classes/VelocityEstimator.h"
+
+/**
+ * Phase locked loop velocity estimator
+ *
+ * Second order tracking loop on the sensor angle: the estimated angle is advanced with the
+ * estimated velocity and both are corrected by the error to the measured angle,
+ *   angle_est += (velocity + kp*err)*Ts
+ *   velocity  += ki*err*Ts
+ * With kp = 2*bandwidth and ki = bandwidth^2 the loop is critically damped.
+ * The angles are kept as 64 bit binary angles, so the error is exact at any number of turns.
+ * A constant velocity is tracked without lag, a constant acceleration with a lag of
+ * acceleration/bandwidth^2 in angle.
+ */
+class PLLVelocityEstimator : public VelocityEstimator
+{
+  public:
+    /**
+     * @param bandwidth - tracking loop bandwidth [rad/s]
+     */
+    PLLVelocityEstimator(float bandwidth);
+
+    float update(int64_t angle, float Ts) override;
+    void reset(int64_t angle) override;
+
+    float bandwidth; //!< tracking loop bandwidth [rad/s]
+
+  protected:
+    /** refresh the loop gains if the bandwidth changed */
+    void updateGains();
+
+    float bandwidth_cache = 0.0f; //!< bandwidth the gains were computed from
+    float kp = 0.0f; //!< angle correction gain [1/s]
+    float ki = 0.0f; //!< velocity correction gain [1/s^2]
+    int64_t angle_est = 0; //!< estimated multi-turn angle, 2^32 per turn
+    bool initialized = false; //!< estimate started from a measured angle
+};
+
+#endif
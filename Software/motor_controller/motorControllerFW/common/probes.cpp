@@ -0,0 +1,63 @@
+#include "probes.h"
+#include <string.h>
+#include "hardware/sync.h"
+
+volatile ProbeStats probe_stats[PROBE_COUNT];
+
+static const char* const probe_names[PROBE_COUNT] = {
+    "loopFOC",
+    "sensor",
+    "elec_angle",
+    "torque_ctrl",
+    "sincos",
+    "set_pwm",
+    "move",
+    "shaft_state",
+    "motion_ctrl",
+};
+
+void probesInit() {
+    _cycleCounterInit();
+    probesReset();
+}
+
+void probesReset() {
+    // the stages are recorded from interrupts on this core
+    uint32_t irq_state = save_and_disable_interrupts();
+    for (int i = 0; i < PROBE_COUNT; i++) {
+        volatile ProbeStats& s = probe_stats[i];
+        s.count = 0;
+        s.min = UINT32_MAX;
+        s.max = 0;
+        s.sum = 0;
+        for (int b = 0; b < PROBE_HIST_BINS; b++) s.hist[b] = 0;
+    }
+    restore_interrupts(irq_state);
+}
+
+void probeRecord(ProbeStage stage, uint32_t cycles) {
+    volatile ProbeStats& s = probe_stats[stage];
+    s.count++;
+    s.sum += cycles;
+    if (cycles < s.min) s.min = cycles;
+    if (cycles > s.max) s.max = cycles;
+    // bin = number of significant bits
+    uint32_t bin = cycles ? 32 - __builtin_clz(cycles) : 0;
+    if (bin >= PROBE_HIST_BINS) bin = PROBE_HIST_BINS - 1;
+    s.hist[bin]++;
+}
+
+void probeRead(ProbeStage stage, ProbeStats* stats) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    volatile ProbeStats& s = probe_stats[stage];
+    stats->count = s.count;
+    stats->min = s.min;
+    stats->max = s.max;
+    stats->sum = s.sum;
+    for (int b = 0; b < PROBE_HIST_BINS; b++) stats->hist[b] = s.hist[b];
+    restore_interrupts(irq_state);
+}
+
+const char* probeName(ProbeStage stage) {
+    return stage < PROBE_COUNT ? probe_names[stage] : "?";
+}
@@ -0,0 +1,77 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+#include <stdint.h>
+#include "cycle_counter.h"
+
+// Per stage cycle count instrumentation of loopFOC and move
+// With SIMPLEFOC_PROBES 0 (default) all the probe macros compile to nothing.
+#ifndef SIMPLEFOC_PROBES
+#define SIMPLEFOC_PROBES 0
+#endif
+
+#define PROBE_HIST_BINS 24 //!< log2 histogram bins, bin n counts durations in [2^(n-1), 2^n) cycles
+
+/**
+ * Instrumented stages
+ */
+enum ProbeStage : uint8_t {
+    PROBE_LOOPFOC = 0,          //!< whole loopFOC()
+    PROBE_SENSOR_UPDATE,        //!< sensor->update() - the I2C read, or the newest background sample
+    PROBE_ELECTRICAL_ANGLE,     //!< electricalAngle()
+    PROBE_TORQUE_CONTROL,       //!< current sensing, filters and current PIDs
+    PROBE_SINCOS,               //!< sine and cosine of the electrical angle
+    PROBE_SET_PWM,              //!< inverse Park and driver->setPwm()
+    PROBE_MOVE,                 //!< whole move()
+    PROBE_SHAFT_STATE,          //!< shaftAngle() and shaftVelocity()
+    PROBE_MOTION_CONTROL,       //!< angle/velocity controllers
+    PROBE_COUNT
+};
+
+/**
+ * Statistics of one stage, all times in processor cycles
+ */
+struct ProbeStats {
+    uint32_t count; //!< number of measurements
+    uint32_t min; //!< shortest duration
+    uint32_t max; //!< longest duration
+    uint64_t sum; //!< sum of all durations, mean = sum / count
+    uint32_t hist[PROBE_HIST_BINS]; //!< log2 histogram of the durations
+};
+
+extern volatile ProbeStats probe_stats[PROBE_COUNT];
+
+/** start the cycle counter of the calling core and clear the statistics */
+void probesInit();
+/** clear the statistics of all stages */
+void probesReset();
+/** add one measurement to a stage */
+void probeRecord(ProbeStage stage, uint32_t cycles);
+/** read a consistent copy of the statistics of a stage */
+void probeRead(ProbeStage stage, ProbeStats* stats);
+/** name of a stage */
+const char* probeName(ProbeStage stage);
+
+#if SIMPLEFOC_PROBES
+/** measure a stage: PROBE_START(name) ... PROBE_END(name, stage) */
+#define PROBE_START(name) uint32_t _probe_##name = _cycles()
+#define PROBE_END(name, stage) probeRecord(stage, _cyclesSince(_probe_##name))
+/** measure from here to the end of the enclosing scope */
+#define PROBE_SCOPE(stage) ProbeScope _probe_scope_##stage(stage)
+
+/** records the lifetime of the object, covers early returns */
+class ProbeScope {
+  public:
+    ProbeScope(ProbeStage _stage) : stage(_stage), start(_cycles()) {}
+    ~ProbeScope() { probeRecord(stage, _cyclesSince(start)); }
+  private:
+    ProbeStage stage;
+    uint32_t start;
+};
+#else
+#define PROBE_START(name)
+#define PROBE_END(name, stage)
+#define PROBE_SCOPE(stage)
+#endif
+
+#endif
@@ -0,0 +1,166 @@
+#include "sensor_calibration.h"
+#include "foc_utils.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+SensorCalibration::SensorCalibration()
+{
+    memset(table, 0, sizeof(table));
+    begin();
+}
+
+void SensorCalibration::begin()
+{
+    memset(ata, 0, sizeof(ata));
+    memset(atb, 0, sizeof(atb));
+    memset(coverage, 0, sizeof(coverage));
+    ete = 0.0;
+    samples = 0;
+    first_error = 0;
+}
+
+void SensorCalibration::basis(uint32_t measured, double* phi)
+{
+    double c1 = cos(measured * (2.0 * M_PI / 4294967296.0));
+    double s1 = sin(measured * (2.0 * M_PI / 4294967296.0));
+    double c = 1.0, s = 0.0;
+    phi[0] = 1.0;
+    for (int k = 1; k <= SENSOR_CALIBRATION_HARMONICS; k++) {
+        // angle addition, one sin/cos pair per sample
+        double ck = c * c1 - s * s1;
+        s = s * c1 + c * s1;
+        c = ck;
+        phi[2 * k - 1] = c;
+        phi[2 * k] = s;
+    }
+}
+
+void SensorCalibration::addSample(uint32_t reference, uint32_t measured)
+{
+    if (samples == 0) first_error = measured - reference;
+    // relative to the first sample the error stays far from the wraparound
+    double e = (int32_t)(measured - reference - first_error) / 4294967296.0;
+    double phi[SENSOR_CALIBRATION_TERMS];
+    basis(measured, phi);
+    for (int i = 0; i < SENSOR_CALIBRATION_TERMS; i++) {
+        for (int j = i; j < SENSOR_CALIBRATION_TERMS; j++) ata[i][j] += phi[i] * phi[j];
+        atb[i] += phi[i] * e;
+    }
+    ete += e * e;
+    samples++;
+    uint32_t index = measured >> (32 - SENSOR_CALIBRATION_BITS);
+    coverage[index >> 3] |= 1 << (index & 7);
+}
+
+int SensorCalibration::fit()
+{
+    for (int i = 0; i < SENSOR_CALIBRATION_SIZE / 8; i++)
+        if (coverage[i] != 0xFF) return 0;
+    if (samples < 2 * SENSOR_CALIBRATION_TERMS) return 0;
+
+    // solve the normal equations in place, gaussian elimination with partial pivoting
+    double b[SENSOR_CALIBRATION_TERMS];
+    memcpy(b, atb, sizeof(b));
+    for (int i = 0; i < SENSOR_CALIBRATION_TERMS; i++)
+        for (int j = 0; j < i; j++) ata[i][j] = ata[j][i];
+    for (int col = 0; col < SENSOR_CALIBRATION_TERMS; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < SENSOR_CALIBRATION_TERMS; row++)
+            if (fabs(ata[row][col]) > fabs(ata[pivot][col])) pivot = row;
+        if (fabs(ata[pivot][col]) < 1e-9 * samples) return 0;
+        if (pivot != col) {
+            for (int j = 0; j < SENSOR_CALIBRATION_TERMS; j++) {
+                double t = ata[col][j]; ata[col][j] = ata[pivot][j]; ata[pivot][j] = t;
+            }
+            double t = b[col]; b[col] = b[pivot]; b[pivot] = t;
+        }
+        for (int row = col + 1; row < SENSOR_CALIBRATION_TERMS; row++) {
+            double f = ata[row][col] / ata[col][col];
+            for (int j = col; j < SENSOR_CALIBRATION_TERMS; j++) ata[row][j] -= f * ata[col][j];
+            b[row] -= f * b[col];
+        }
+    }
+    double x[SENSOR_CALIBRATION_TERMS];
+    for (int row = SENSOR_CALIBRATION_TERMS - 1; row >= 0; row--) {
+        double sum = b[row];
+        for (int j = row + 1; j < SENSOR_CALIBRATION_TERMS; j++) sum -= ata[row][j] * x[j];
+        x[row] = sum / ata[row][row];
+    }
+
+    // residual sum of squares of the least squares solution: e'e - x'A'e
+    double fitted = 0.0;
+    for (int i = 0; i < SENSOR_CALIBRATION_TERMS; i++) fitted += x[i] * atb[i];
+    double mean = atb[0] / samples;
+    rms_before = (float)(sqrt(fmax(ete / samples - mean * mean, 0.0)) * 2.0 * M_PI);
+    rms_after = (float)(sqrt(fmax((ete - fitted) / samples, 0.0)) * 2.0 * M_PI);
+
+    offset = first_error + (uint32_t)(int32_t)lround(x[0] * 4294967296.0);
+    int32_t largest = 0;
+    double phi[SENSOR_CALIBRATION_TERMS];
+    for (int i = 0; i < SENSOR_CALIBRATION_SIZE; i++) {
+        basis((uint32_t)i << (32 - SENSOR_CALIBRATION_BITS), phi);
+        double e = 0.0;
+        for (int k = 1; k < SENSOR_CALIBRATION_TERMS; k++) e += x[k] * phi[k];
+        table[i] = (int32_t)lround(e * 4294967296.0);
+        if (abs(table[i]) > largest) largest = abs(table[i]);
+    }
+    max_correction = largest * _TURNS32_TO_RAD;
+    valid = true;
+    // the accumulators are spent, a new fit starts with begin()
+    samples = 0;
+    return 1;
+}
+
+float SensorCalibration::error(uint32_t reference, uint32_t measured, bool corrected) const
+{
+    uint32_t angle = corrected ? correct(measured) : measured;
+    return (int32_t)(angle - reference - offset) * _TURNS32_TO_RAD;
+}
+
+uint32_t SensorCalibration::checksum(const SensorCalibrationRecord& record)
+{
+    const uint8_t* data = (const uint8_t*)&record;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(SensorCalibrationRecord, checksum); i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void SensorCalibration::toRecord(SensorCalibrationRecord& record) const
+{
+    memset(&record, 0, sizeof(record));
+    record.magic = SENSOR_CALIBRATION_MAGIC;
+    record.version = SENSOR_CALIBRATION_VERSION;
+    record.size = SENSOR_CALIBRATION_SIZE;
+    memcpy(record.table, table, sizeof(table));
+    record.checksum = checksum(record);
+}
+
+int SensorCalibration::fromRecord(const SensorCalibrationRecord& record)
+{
+    if (record.magic != SENSOR_CALIBRATION_MAGIC || record.version != SENSOR_CALIBRATION_VERSION
+        || record.size != SENSOR_CALIBRATION_SIZE || record.checksum != checksum(record))
+        return 0;
+    memcpy(table, record.table, sizeof(table));
+    int32_t largest = 0;
+    for (int i = 0; i < SENSOR_CALIBRATION_SIZE; i++)
+        if (abs(table[i]) > largest) largest = abs(table[i]);
+    max_correction = largest * _TURNS32_TO_RAD;
+    valid = true;
+    return 1;
+}
+
+// flash storage is board specific, see sensor_calibration_rp2040.cpp
+__attribute__((weak)) int SensorCalibration::load()
+{
+    return 0;
+}
+
+__attribute__((weak)) int SensorCalibration::save()
+{
+    return 0;
+}
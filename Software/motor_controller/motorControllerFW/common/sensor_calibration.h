@@ -0,0 +1,117 @@
+#ifndef SENSOR_CALIBRATION_H
+#define SENSOR_CALIBRATION_H
+
+#include <stdint.h>
+
+#ifndef SENSOR_CALIBRATION_BITS
+#define SENSOR_CALIBRATION_BITS 7 //!< log2 of the table entries per turn
+#endif
+#ifndef SENSOR_CALIBRATION_HARMONICS
+#define SENSOR_CALIBRATION_HARMONICS 8 //!< harmonics of the turn fitted to the angle error
+#endif
+#define SENSOR_CALIBRATION_SIZE (1 << SENSOR_CALIBRATION_BITS)
+#define SENSOR_CALIBRATION_TERMS (2 * SENSOR_CALIBRATION_HARMONICS + 1)
+#define SENSOR_CALIBRATION_MAGIC 0x4C434553 // "SECL"
+#define SENSOR_CALIBRATION_VERSION 1
+
+/**
+ * Stored form of a calibration, the checksum covers everything before it
+ */
+struct SensorCalibrationRecord {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size; //!< table entries
+    int32_t table[SENSOR_CALIBRATION_SIZE];
+    uint32_t checksum;
+};
+
+/**
+ * Sensor nonlinearity (eccentricity) correction
+ *
+ * An off-axis magnet makes the sensor angle run ahead and behind the shaft once per turn, plus
+ * smaller higher harmonics. The electrical angle multiplies this error by the pole pairs.
+ * The error is fitted from a sweep of reference angles (open-loop steps, see StepperMotor::calibrateSensor())
+ * against the measured angles: least squares on a constant plus SENSOR_CALIBRATION_HARMONICS harmonics
+ * of the measured angle, accumulated sample by sample so the sweep is never stored.
+ * The fit is baked into a table of the error over the measured angle, correct() subtracts the linearly
+ * interpolated entry - a few integer operations per update.
+ * The constant part is left out of the table: it is just a zero offset, found by the sensor alignment.
+ */
+class SensorCalibration
+{
+  public:
+    SensorCalibration();
+
+    /** start a new fit, clears the accumulated samples */
+    void begin();
+    /**
+     * add one sample of the sweep
+     * @param reference  reference angle (2^32 per turn), increasing in the direction the sensor counts
+     * @param measured  uncorrected sensor angle (2^32 per turn)
+     */
+    void addSample(uint32_t reference, uint32_t measured);
+    /**
+     * solve the fit and fill the table
+     * @returns 1 on success, 0 if there are too few samples or they do not cover the turn
+     */
+    int fit();
+
+    /** corrected angle, the table error at the measured angle subtracted */
+    inline uint32_t correct(uint32_t measured) const {
+        uint32_t index = measured >> (32 - SENSOR_CALIBRATION_BITS);
+        int32_t frac = (int32_t)((measured >> (16 - SENSOR_CALIBRATION_BITS)) & 0xFFFF);
+        int32_t e0 = table[index];
+        int32_t e1 = table[(index + 1) & (SENSOR_CALIBRATION_SIZE - 1)];
+        return measured - (uint32_t)(e0 + (int32_t)(((int64_t)(e1 - e0) * frac) >> 16));
+    }
+
+    /**
+     * error of a sample against the fit, for validation
+     * @param corrected  apply the table, false for the error of the raw angle
+     * @returns error [rad], relative to the fitted offset
+     */
+    float error(uint32_t reference, uint32_t measured, bool corrected = true) const;
+
+    /** stored form of the table */
+    void toRecord(SensorCalibrationRecord& record) const;
+    /**
+     * load the table from its stored form
+     * @returns 1 on success, 0 if the record is not valid (magic, version, size or checksum)
+     */
+    int fromRecord(const SensorCalibrationRecord& record);
+    /** checksum (FNV-1a) of a record, without its checksum field */
+    static uint32_t checksum(const SensorCalibrationRecord& record);
+
+    /**
+     * load the table from flash
+     * @returns 1 if a valid table was found
+     */
+    int load();
+    /**
+     * store the table in flash (last sector)
+     * The other core has to be running flash_safe_execute_core_init(), it is paused while the sector is written.
+     * @returns 1 on success
+     */
+    int save();
+
+    int32_t table[SENSOR_CALIBRATION_SIZE]; //!< error over the measured angle, 2^32 per turn
+    bool valid = false; //!< table fitted or loaded
+    uint32_t offset = 0; //!< fitted constant error (2^32 per turn), measured = reference + offset + table error
+    float rms_before = 0.0f; //!< RMS error of the sweep without the correction [rad]
+    float rms_after = 0.0f; //!< RMS residual of the sweep after the correction [rad]
+    float max_correction = 0.0f; //!< largest table entry [rad]
+
+  protected:
+    /** basis functions of the fit at a measured angle: 1, cos(k*a), sin(k*a) */
+    static void basis(uint32_t measured, double* phi);
+
+    // normal equations of the least squares fit, errors in turns relative to the first sample
+    double ata[SENSOR_CALIBRATION_TERMS][SENSOR_CALIBRATION_TERMS];
+    double atb[SENSOR_CALIBRATION_TERMS];
+    double ete = 0.0; //!< sum of the squared errors
+    uint32_t samples = 0;
+    uint32_t first_error = 0; //!< error of the first sample, the others are taken relative to it
+    uint8_t coverage[SENSOR_CALIBRATION_SIZE / 8] = {0}; //!< table intervals that received a sample, one bit each
+};
+
+#endif
@@ -0,0 +1,37 @@
+#include "sensor_calibration.h"
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include <string.h>
+
+// RP2040 flash storage of the calibration table, overrides the weak load() and save() in sensor_calibration.cpp
+// The table lives in the last sector of the flash, away from the program image.
+
+#define SENSOR_CALIBRATION_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define SENSOR_CALIBRATION_FLASH_BYTES ((sizeof(SensorCalibrationRecord) + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE)
+
+static_assert(SENSOR_CALIBRATION_FLASH_BYTES <= FLASH_SECTOR_SIZE, "calibration record does not fit one flash sector");
+
+int SensorCalibration::load()
+{
+    const SensorCalibrationRecord* stored = (const SensorCalibrationRecord*)(XIP_BASE + SENSOR_CALIBRATION_FLASH_OFFSET);
+    return fromRecord(*stored);
+}
+
+// runs with the interrupts off and the other core paused, nothing here may execute from flash
+static void __not_in_flash_func(write_sector)(void* data)
+{
+    flash_range_erase(SENSOR_CALIBRATION_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(SENSOR_CALIBRATION_FLASH_OFFSET, (const uint8_t*)data, SENSOR_CALIBRATION_FLASH_BYTES);
+}
+
+int SensorCalibration::save()
+{
+    if (!valid) return 0;
+    // page sized buffer, the padding is programmed as erased flash
+    alignas(4) static uint8_t buffer[SENSOR_CALIBRATION_FLASH_BYTES];
+    memset(buffer, 0xFF, sizeof(buffer));
+    toRecord(*(SensorCalibrationRecord*)buffer);
+    if (flash_safe_execute(write_sector, buffer, 100) != PICO_OK) return 0;
+    // read back through XIP
+    return memcmp((const void*)(XIP_BASE + SENSOR_CALIBRATION_FLASH_OFFSET), buffer, sizeof(SensorCalibrationRecord)) == 0;
+}
@@ -0,0 +1,104 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <string.h>
+#include "hardware/sync.h"
+
+/**
+ * Lock-free single producer / single consumer ring of fixed size records
+ *
+ * Meant for passing data between the two cores (or from an interrupt to the main loop)
+ * without either side ever waiting on the other:
+ * - the producer never blocks, on overflow the oldest records are overwritten (drop oldest)
+ * - the producer only writes head and the slots, the consumer only writes its own read index,
+ *   so no atomic read-modify-write is needed (the RP2040 has none between cores)
+ * - every slot carries a sequence number, odd while the producer is writing it and even once the record
+ *   is complete, so the consumer detects a record that was overwritten while it was being copied
+ *
+ * @param T record type, copied with memcpy
+ * @param N number of slots, power of two
+ */
+template <typename T, uint32_t N>
+class SPSCRing {
+    static_assert(N && !(N & (N - 1)), "SPSCRing size has to be a power of two");
+  public:
+    /**
+     * Producer side - append a record, overwriting the oldest one if the ring is full
+     * @param record  record to copy into the ring
+     */
+    void push(const T& record) {
+        uint32_t h = head;
+        Slot& slot = slots[h & (N - 1)];
+        slot.seq = 2 * h + 1; // writing
+        __dmb();
+        memcpy(&slot.data, &record, sizeof(T));
+        __dmb();
+        slot.seq = 2 * h + 2; // record h complete
+        __dmb();
+        head = h + 1;
+    }
+
+    /**
+     * Consumer side - take the oldest available record
+     * @param record  destination of the record
+     * @returns true if a record was read, false if the ring is empty
+     */
+    bool pop(T* record) {
+        while (true) {
+            uint32_t h = head;
+            __dmb();
+            if (h == tail) return false;
+            // the producer lapped the consumer - skip to the oldest record still in the ring
+            if (h - tail > N) {
+                dropped += h - tail - N;
+                tail = h - N;
+            }
+            Slot& slot = slots[tail & (N - 1)];
+            uint32_t seq = slot.seq;
+            __dmb();
+            memcpy(record, &slot.data, sizeof(T));
+            __dmb();
+            if (seq == 2 * tail + 2 && slot.seq == seq) {
+                tail++;
+                popped++;
+                return true;
+            }
+            // overwritten while copying, it is lost - try the next one
+            dropped++;
+            tail++;
+        }
+    }
+
+    /**
+     * Consumer side - take up to max of the oldest available records
+     * @param records  destination array
+     * @param max  size of the destination array
+     * @returns number of records read
+     */
+    uint32_t pop(T* records, uint32_t max) {
+        uint32_t n = 0;
+        while (n < max && pop(&records[n])) n++;
+        return n;
+    }
+
+    /** number of records pushed since start */
+    uint32_t pushed() const { return head; }
+    /** number of records read by the consumer since start */
+    uint32_t consumed() const { return popped; }
+    /** number of records overwritten before the consumer read them */
+    uint32_t overflows() const { return dropped; }
+
+  private:
+    struct Slot {
+        volatile uint32_t seq = 0; //!< 2*index+1 while writing, 2*index+2 when record index is complete
+        T data;
+    };
+    Slot slots[N];
+    volatile uint32_t head = 0; //!< written by the producer only, total records pushed
+    volatile uint32_t tail = 0; //!< written by the consumer only, next record to read
+    volatile uint32_t popped = 0; //!< written by the consumer only
+    volatile uint32_t dropped = 0; //!< written by the consumer only
+};
+
+#endif
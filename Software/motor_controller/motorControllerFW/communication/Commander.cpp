@@ -1,6 +1,7 @@
 // Ported Commander.cpp for Raspberry Pi Pico SDK (C++)
 
 #include "Commander.h"
+#include "hardware/clocks.h"
 
 Commander::Commander(char eol, bool echo) {
   this->eol = eol;
@@ -75,6 +76,63 @@ void Commander::run(char* user_input) {
   }
 }
 
+void Commander::probes(char* user_cmd) {
+  ProbeStats stats;
+  switch(user_cmd[0]) {
+    case SCMD_PROBE_RESET:
+      probesReset();
+      printVerbose("Probes reset");
+      println("");
+      break;
+    case SCMD_PROBE_HIST: {
+      int stage = atoi(&user_cmd[1]);
+      if(stage < 0 || stage >= PROBE_COUNT) {
+        printError();
+        break;
+      }
+      probeRead((ProbeStage)stage, &stats);
+      println(probeName((ProbeStage)stage));
+      // bin b holds the durations below 2^b cycles
+      for(int b = 0; b < PROBE_HIST_BINS; b++) {
+        if(!stats.hist[b]) continue;
+        print("<");
+        print((int)(1u << b));
+        print(": ");
+        println((int)stats.hist[b]);
+      }
+      break;
+    }
+    default: {
+      if(!SIMPLEFOC_PROBES) printVerbose("Probes not compiled in (SIMPLEFOC_PROBES)\n");
+      float us_per_cycle = 1e6f / clock_get_hz(clk_sys);
+      for(int i = 0; i < PROBE_COUNT; i++) {
+        probeRead((ProbeStage)i, &stats);
+        uint32_t mean = stats.count ? (uint32_t)(stats.sum / stats.count) : 0;
+        uint32_t min = stats.count ? stats.min : 0;
+        print(i);
+        print(" ");
+        print(probeName((ProbeStage)i));
+        print(" n:");
+        print((int)stats.count);
+        print(" min/mean/max:");
+        print((int)min);
+        print("/");
+        print((int)mean);
+        print("/");
+        print((int)stats.max);
+        print(" cycles ");
+        print(min * us_per_cycle);
+        print("/");
+        print(mean * us_per_cycle);
+        print("/");
+        print(stats.max * us_per_cycle);
+        println(" us");
+      }
+      break;
+    }
+  }
+}
+
 void Commander::print(const int number) {
   if(verbose == VerboseMode::nothing) return;
   printf("%d", number);
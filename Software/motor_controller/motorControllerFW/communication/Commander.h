@@ -4,6 +4,7 @@
 #include "../common/base_classes/FOCMotor.h"
 #include "../common/pid.h"
 #include "../common/lowpass_filter.h"
+#include "../common/probes.h"
 #include "commands.h"
 
 #include <cstdio>
@@ -61,18 +62,6 @@ class Commander
      *    '?' - Scan command - displays all the labels of attached nodes
      */
     void run();
-    /**
-     * Function reading the string of user input and firing callbacks that have been added to the commander
-     * once the user has requested them - when he sends the command
-     *
-     *  - It has default commands (the letters can be changed in the commands.h file)
-     *    '@' - Verbose mode
-     *    '#' - Number of decimal places
-     *    '?' - Scan command - displays all the labels of attached nodes
-     *
-     * @param eol - temporary end of line sentinel
-     */
-    void run(char eol = '\n');
     /**
      * Function reading the string of user input and firing callbacks that have been added to the commander
      * once the user has requested them - when he sends the command
@@ -240,6 +229,17 @@ class Commander
      */
     void motion(FOCMotor* motor, char* user_cmd, char* separator = (char *)" ");
 
+    /**
+     * Cycle count probe interface (common/probes.h)
+     * @param user_cmd - the string command
+     *
+     * Commands:
+     *    ''  - print count, min, mean and max execution time of every stage [cycles] and [us]
+     *    'R' - reset the statistics
+     *    'H' - print the log2 histogram of one stage (ex. H0 for loopFOC)
+     */
+    void probes(char* user_cmd);
+
     bool isSentinel(char ch);
   private:
     // Subscribed command callback variables
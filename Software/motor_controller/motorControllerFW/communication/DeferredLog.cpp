@@ -0,0 +1,100 @@
+#include "DeferredLog.h"
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+// one ring per core, producers are the code running on that core, the consumer is deferredLogDrain()
+static LogRing log_rings[2];
+
+void deferredLogPush(LogRecord& record) {
+    // interrupts of this core are disabled so that an interrupt handler logging on the same core
+    // can not interleave with the push - that keeps a single producer per ring
+    uint32_t irq_state = save_and_disable_interrupts();
+    log_rings[get_core_num()].push(record);
+    restore_interrupts(irq_state);
+}
+
+// print a piece of the format string without conversions as it is, in chunks of the buffer
+static void printLiteral(const char* p, size_t len) {
+    char chunk[96];
+    while (len > 0) {
+        size_t n = (len < sizeof(chunk)) ? len : sizeof(chunk) - 1;
+        memcpy(chunk, p, n);
+        chunk[n] = 0;
+        fputs(chunk, stdout);
+        p += n;
+        len -= n;
+    }
+}
+
+// print a single conversion specification with its argument, the spec is the whole format string
+static void printConversion(const char* spec, const LogRecord& record, int arg) {
+    uint32_t raw = record.args[arg];
+    switch ((record.types >> (2 * arg)) & 0x3) {
+        case LOG_ARG_FLOAT: {
+            union { uint32_t u; float f; } conv = { .u = raw };
+            printf(spec, (double)conv.f);
+            break;
+        }
+        case LOG_ARG_PTR:
+            printf(spec, (const void*)(uintptr_t)raw);
+            break;
+        case LOG_ARG_INT:
+            printf(spec, (int)raw);
+            break;
+        default:
+            printf(spec, (unsigned)raw);
+            break;
+    }
+}
+
+// format the record: the text between the conversions goes out literally, %% as a percent sign,
+// and every conversion is printed on its own by printf with its one argument
+static void printRecord(const LogRecord& record) {
+    char spec[32];
+    const char* p = record.fmt;
+    int arg = 0;
+    while (*p) {
+        const char* end = strchr(p, '%');
+        if (!end) {
+            printLiteral(p, strlen(p));
+            break;
+        }
+        printLiteral(p, end - p);
+        if (end[1] == '%') {
+            putchar('%');
+            p = end + 2;
+            continue;
+        }
+        // skip flags, width, precision and length up to the conversion character
+        p = end++;
+        while (*end && !strchr("diouxXcsfFeEgGaAp", *end)) end++;
+        if (*end) end++;
+        size_t len = end - p;
+        // a conversion without its argument (or not a conversion at all) is printed as it is
+        if (arg >= record.nargs || len >= sizeof(spec) || !strchr("diouxXcsfFeEgGaAp", end[-1])) {
+            printLiteral(p, len);
+        } else {
+            memcpy(spec, p, len);
+            spec[len] = 0;
+            printConversion(spec, record, arg++);
+        }
+        p = end;
+    }
+}
+
+uint32_t deferredLogDrain(uint32_t max_records) {
+    LogRecord record;
+    uint32_t n = 0;
+    for (int core = 0; core < 2; core++) {
+        while (n < max_records && log_rings[core].pop(&record)) {
+            printRecord(record);
+            n++;
+        }
+    }
+    return n;
+}
+
+uint32_t deferredLogDropped() {
+    return log_rings[0].overflows() + log_rings[1].overflows();
+}
@@ -0,0 +1,98 @@
+#ifndef DEFERREDLOG_H
+#define DEFERREDLOG_H
+
+#include <stdint.h>
+#include <type_traits>
+#include "common/spsc_ring.h"
+
+#ifndef DEFERRED_LOG_RING_SIZE
+#define DEFERRED_LOG_RING_SIZE 64 //!< records buffered per core
+#endif
+#define DEFERRED_LOG_MAX_ARGS 4 //!< arguments per record
+
+/**
+ * Deferred binary logging
+ *
+ * DLOG("fmt", args...) costs a few dozen cycles in the caller: it stores the format string pointer
+ * and the raw 32 bit arguments into a RAM ring, without formatting anything.
+ * Floats are stored as floats (not promoted to double), integers and pointers as 32 bit words.
+ * The formatting and the USB/UART output happen later in deferredLogDrain(), called from the main loop.
+ *
+ * Restrictions compared to printf:
+ * - at most DEFERRED_LOG_MAX_ARGS arguments, no 64 bit arguments
+ * - the format string and any %s argument have to stay valid until drained (string literals)
+ *
+ * Every core has its own ring, so DLOG can be used from any context including interrupts,
+ * the push is done with the interrupts of the calling core disabled to keep a single producer per ring.
+ * If a ring overflows, the oldest records are dropped and counted.
+ */
+
+/** type of a stored argument */
+enum LogArgType : uint8_t {
+    LOG_ARG_INT = 0,
+    LOG_ARG_UINT = 1,
+    LOG_ARG_FLOAT = 2,
+    LOG_ARG_PTR = 3,
+};
+
+/** One deferred log record */
+struct LogRecord {
+    const char* fmt; //!< format string, also identifies the message
+    uint8_t nargs; //!< number of arguments
+    uint8_t types; //!< LogArgType of each argument, 2 bits per argument
+    uint32_t args[DEFERRED_LOG_MAX_ARGS]; //!< raw arguments
+};
+
+typedef SPSCRing<LogRecord, DEFERRED_LOG_RING_SIZE> LogRing;
+
+/** push a record into the ring of the calling core */
+void deferredLogPush(LogRecord& record);
+
+/**
+ * Format and print the buffered records of both cores, oldest first per core
+ * @param max_records  maximum number of records printed in this call, limits the time spent
+ * @returns number of records printed
+ */
+uint32_t deferredLogDrain(uint32_t max_records);
+
+/** number of records dropped because a ring overflowed */
+uint32_t deferredLogDropped();
+
+// argument capture - no default promotions, each argument is one 32 bit word
+static inline void logStoreArg(LogRecord& r, uint8_t i, float v) {
+    union { float f; uint32_t u; } conv = { .f = v };
+    r.args[i] = conv.u;
+    r.types |= LOG_ARG_FLOAT << (2 * i);
+}
+static inline void logStoreArg(LogRecord& r, uint8_t i, double v) {
+    logStoreArg(r, i, (float)v);
+}
+static inline void logStoreArg(LogRecord& r, uint8_t i, const void* v) {
+    r.args[i] = (uint32_t)(uintptr_t)v;
+    r.types |= LOG_ARG_PTR << (2 * i);
+}
+template <typename T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, int>::type = 0>
+static inline void logStoreArg(LogRecord& r, uint8_t i, T v) {
+    static_assert(sizeof(T) <= sizeof(uint32_t), "64 bit arguments are not supported by DLOG");
+    r.args[i] = (uint32_t)v;
+    if (std::is_signed<T>::value) r.types |= LOG_ARG_INT << (2 * i);
+    else r.types |= LOG_ARG_UINT << (2 * i);
+}
+
+/** capture a log call, use through DLOG */
+template <typename... Args>
+static inline void deferredLog(const char* fmt, Args... args) {
+    static_assert(sizeof...(Args) <= DEFERRED_LOG_MAX_ARGS, "too many DLOG arguments");
+    LogRecord record;
+    record.fmt = fmt;
+    record.nargs = sizeof...(Args);
+    record.types = 0;
+    uint8_t i = 0;
+    (void)i;
+    (logStoreArg(record, i++, args), ...);
+    deferredLogPush(record);
+}
+
+#define DLOG(fmt, ...) deferredLog(fmt, ##__VA_ARGS__)
+
+#endif
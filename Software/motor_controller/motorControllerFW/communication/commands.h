@@ -47,6 +47,9 @@
 
  #define SCMD_PWMMOD_TYPE   'T'  //!<< Pwm modulation type
  #define SCMD_PWMMOD_CENTER 'C'  //!<< Pwm modulation center flag
+ // probes
+ #define SCMD_PROBE_RESET 'R' //!< Reset the probe statistics
+ #define SCMD_PROBE_HIST  'H' //!< Histogram of one probe stage
 
 
 #endif
\ No newline at end of file
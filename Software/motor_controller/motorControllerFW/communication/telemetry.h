@@ -0,0 +1,90 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <string.h>
+#include "common/spsc_ring.h"
+
+#ifndef TELEMETRY_RING_SIZE
+#define TELEMETRY_RING_SIZE 32 //!< records buffered between core0 and the CAN transmitter on core1
+#endif
+#ifndef TELEMETRY_TX_BATCH
+#define TELEMETRY_TX_BATCH 4 //!< records taken from the ring at once by the transmitter (can2040 queues 4 frames)
+#endif
+
+/**
+ * Telemetry record types, the value is the CAN id relative to the motor base id (thisMotor << 8)
+ */
+enum TelemetryType : uint8_t {
+    TELEMETRY_ANGLE = 0x18, //!< sensor angle [rad] and velocity [rad/s] as floats
+    TELEMETRY_PROBE = 0x1A, //!< cycle count statistics of one probe stage, see telemetryProbe()
+    TELEMETRY_LOAD_TORQUE = 0x1B, //!< estimated load torque [Nm] as float
+    TELEMETRY_BUS_VOLTAGE = 0x1C, //!< bus voltage event, see telemetryBusVoltage()
+};
+
+/**
+ * Bus voltage state, reported with TELEMETRY_BUS_VOLTAGE when it changes
+ */
+enum BusVoltageState : uint8_t {
+    BUS_VOLTAGE_OK = 0, //!< back within the limits
+    BUS_VOLTAGE_UNDER = 1, //!< below the undervoltage limit
+    BUS_VOLTAGE_OVER = 2, //!< above the overvoltage limit
+};
+
+// probe request (relative CAN id 0x19) data[0] values besides a stage index
+#define PROBE_REQUEST_ALL 0xFE //!< send the statistics of all stages
+#define PROBE_REQUEST_RESET 0xFF //!< clear the statistics
+#define PROBE_REQUEST_NONE 0xFD //!< no request pending
+
+/**
+ * One telemetry record, sent as one CAN frame
+ */
+struct TelemetryRecord {
+    uint8_t type; //!< TelemetryType
+    uint8_t dlc; //!< number of valid data bytes
+    uint8_t data[8]; //!< payload, sent as is
+};
+
+/** Ring carrying telemetry from core0 (single producer) to core1 (single consumer) */
+typedef SPSCRing<TelemetryRecord, TELEMETRY_RING_SIZE> TelemetryRing;
+
+/** Record carrying a single float */
+static inline TelemetryRecord telemetryFloat(TelemetryType type, float value) {
+    TelemetryRecord record = {type, sizeof(float), {0}};
+    memcpy(record.data, &value, sizeof(float));
+    return record;
+}
+
+/** Record carrying two floats */
+static inline TelemetryRecord telemetryFloat2(TelemetryType type, float value0, float value1) {
+    TelemetryRecord record = {type, 2 * sizeof(float), {0}};
+    memcpy(record.data, &value0, sizeof(float));
+    memcpy(record.data + sizeof(float), &value1, sizeof(float));
+    return record;
+}
+
+/**
+ * Record carrying a bus voltage event
+ * data: state (BusVoltageState), bus voltage [V] as float
+ */
+static inline TelemetryRecord telemetryBusVoltage(BusVoltageState state, float voltage) {
+    TelemetryRecord record = {TELEMETRY_BUS_VOLTAGE, 1 + sizeof(float), {state}};
+    memcpy(record.data + 1, &voltage, sizeof(float));
+    return record;
+}
+
+/**
+ * Record carrying the statistics of one probe stage, all times in cycles saturated to 16 bit
+ * data: stage, number of stages, min, mean, max (little endian uint16)
+ */
+static inline TelemetryRecord telemetryProbe(uint8_t stage, uint8_t stages, uint32_t min, uint32_t mean, uint32_t max) {
+    TelemetryRecord record = {TELEMETRY_PROBE, 8, {stage, stages}};
+    uint32_t values[3] = {min, mean, max};
+    for (int i = 0; i < 3; i++) {
+        uint16_t v = values[i] > 0xFFFF ? 0xFFFF : (uint16_t)values[i];
+        memcpy(&record.data[2 + 2 * i], &v, sizeof(v));
+    }
+    return record;
+}
+
+#endif
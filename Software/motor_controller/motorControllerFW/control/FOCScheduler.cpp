@@ -0,0 +1,115 @@
+#include "FOCScheduler.h"
+#include "hardware/pwm.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#include "common/cycle_counter.h"
+
+FOCScheduler* FOCScheduler::active = nullptr;
+
+FOCScheduler::FOCScheduler(FOCMotor* _motor) {
+    motor = _motor;
+}
+
+int FOCScheduler::init(uint pwm_slice, long pwm_frequency) {
+    slice = pwm_slice;
+    cycles_per_pwm = clock_get_hz(clk_sys) / pwm_frequency;
+    pwm_period = 1.0f / pwm_frequency;
+    foc.budget = cycles_per_pwm * foc_divider;
+    motion.budget = foc.budget * motion_divider;
+    active = this;
+
+    // FOC step from the PWM wrap interrupt
+    irq_set_exclusive_handler(PWM_IRQ_WRAP, pwmWrapHandler);
+    irq_set_priority(PWM_IRQ_WRAP, SIMPLEFOC_SCHED_FOC_PRIORITY);
+
+    // motion step from a software interrupt with lower priority
+    motion_irq = user_irq_claim_unused(false);
+    if (motion_irq < 0) return 0;
+    irq_set_exclusive_handler(motion_irq, motionHandler);
+    irq_set_priority(motion_irq, SIMPLEFOC_SCHED_MOTION_PRIORITY);
+    return 1;
+}
+
+void FOCScheduler::start() {
+    // free running SysTick on the processor clock for the execution time measurement
+    _cycleCounterInit();
+    // the rate groups run at fixed rates, the controllers do not need to measure the time
+    float foc_Ts = (float)foc.budget / clock_get_hz(clk_sys);
+    motor->setSampleTimes(foc_Ts, foc_Ts * motion_divider);
+    updateOutputLatency();
+
+    pwm_cnt = 0;
+    foc_cnt = 0;
+    motion_busy = false;
+    irq_set_enabled(motion_irq, true);
+    pwm_clear_irq(slice);
+    pwm_set_irq_enabled(slice, true);
+    irq_set_enabled(PWM_IRQ_WRAP, true);
+}
+
+void FOCScheduler::stop() {
+    // the wrap interrupt may be shared with other slices, only this slice is masked
+    pwm_set_irq_enabled(slice, false);
+    irq_set_enabled(motion_irq, false);
+    motion_busy = false;
+    // the loops may be called from elsewhere now
+    motor->setSampleTimes(0, 0);
+    motor->output_latency_auto = pwm_period;
+}
+
+void FOCScheduler::resetStats() {
+    foc.count = 0; foc.cycles_last = 0; foc.cycles_max = 0; foc.overruns = 0;
+    motion.count = 0; motion.cycles_last = 0; motion.cycles_max = 0; motion.overruns = 0;
+}
+
+void FOCScheduler::account(volatile FOCRateGroupStats& stats, uint32_t cycles) {
+    stats.count++;
+    stats.cycles_last = cycles;
+    if (cycles > stats.cycles_max) stats.cycles_max = cycles;
+    if (cycles > stats.budget) stats.overruns++;
+}
+
+// The duty written by the FOC step is loaded at the next wrap and held for foc_divider pulses,
+// centred on the wraps 1..foc_divider after the one that started the step: on average
+// (foc_divider + 1)/2 PWM periods after the step. A step that reaches setPwm only after one or more
+// further wraps (cycles_last, measured from the wrap to the end of loopFOC) delays them by as many periods.
+void FOCScheduler::updateOutputLatency() {
+    uint32_t late = foc.cycles_last / cycles_per_pwm;
+    motor->output_latency_auto = ((foc_divider + 1) * 0.5f + late) * pwm_period;
+}
+
+void FOCScheduler::pwmWrapHandler() {
+    FOCScheduler* s = active;
+    pwm_clear_irq(s->slice);
+    if (++s->pwm_cnt < s->foc_divider) return;
+    s->pwm_cnt = 0;
+
+    uint32_t start = _cycles();
+    s->motor->loopFOC();
+    uint32_t cycles = _cyclesSince(start);
+    account(s->foc, cycles);
+    // wraps during a long step are coalesced into one pending interrupt, count the others here
+    // so the FOC rate does not silently drop below the nominal one
+    uint32_t missed = cycles / s->cycles_per_pwm;
+    s->pwm_cnt = missed ? missed - 1 : 0;
+
+    // trigger the motion rate group
+    if (++s->foc_cnt < s->motion_divider) return;
+    s->foc_cnt = 0;
+    if (s->motion_busy) {
+        s->motion.overruns++; // previous motion step still running, skip this one
+        return;
+    }
+    s->motion_busy = true;
+    irq_set_pending(s->motion_irq);
+}
+
+// execution time includes the time preempted by FOC steps
+void FOCScheduler::motionHandler() {
+    FOCScheduler* s = active;
+    s->updateOutputLatency();
+    uint32_t start = _cycles();
+    s->motor->move();
+    account(s->motion, _cyclesSince(start));
+    s->motion_busy = false;
+}
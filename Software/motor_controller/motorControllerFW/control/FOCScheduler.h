@@ -0,0 +1,97 @@
+#ifndef FOCSCHEDULER_H
+#define FOCSCHEDULER_H
+
+#include "common/base_classes/FOCMotor.h"
+
+// FOC step every N PWM periods - the I2C sensor delivers a new angle about every 110us
+#ifndef SIMPLEFOC_SCHED_FOC_DIVIDER
+#define SIMPLEFOC_SCHED_FOC_DIVIDER 12 //!< 24kHz PWM / 12 = 2kHz FOC loop
+#endif
+// motion (move) step every N FOC steps
+#ifndef SIMPLEFOC_SCHED_MOTION_DIVIDER
+#define SIMPLEFOC_SCHED_MOTION_DIVIDER 10 //!< 2kHz FOC loop / 10 = 200Hz motion loop
+#endif
+// NVIC priorities of the two rate groups, the FOC step preempts the motion step
+#ifndef SIMPLEFOC_SCHED_FOC_PRIORITY
+#define SIMPLEFOC_SCHED_FOC_PRIORITY 0x40
+#endif
+#ifndef SIMPLEFOC_SCHED_MOTION_PRIORITY
+#define SIMPLEFOC_SCHED_MOTION_PRIORITY 0xC0
+#endif
+
+/**
+ * Budget accounting of one rate group, all times in clk_sys cycles
+ */
+struct FOCRateGroupStats {
+    uint32_t count = 0; //!< number of executed steps
+    uint32_t cycles_last = 0; //!< execution time of the last step
+    uint32_t cycles_max = 0; //!< longest execution time since the last reset
+    uint32_t budget = 0; //!< period of the rate group
+    uint32_t overruns = 0; //!< steps that took longer than the budget or were skipped because the previous one was still running
+};
+
+/**
+ * PWM synchronous FOC scheduler
+ *
+ * The inner FOC step (loopFOC) runs from the PWM wrap interrupt every foc_divider PWM periods,
+ * so its rate is fixed by the PWM timer instead of by whatever else the main loop is doing.
+ * The motion step (move) runs as a lower priority rate group every motion_divider FOC steps,
+ * from a software interrupt, so it can be preempted by the next FOC step.
+ *
+ * The PWM slices are started together in syncSlices(), so the wrap of any one slice of the
+ * driver marks the same point of the PWM period for all phases.
+ * Execution times are measured with the SysTick counter (common/cycle_counter.h) of the core
+ * that calls start().
+ */
+class FOCScheduler {
+  public:
+    /**
+     * FOCScheduler class constructor
+     * @param motor  motor whose loopFOC() and move() are scheduled
+     */
+    FOCScheduler(FOCMotor* motor);
+
+    /**
+     * Configure the interrupts, the scheduler is started with start()
+     * @param pwm_slice  PWM slice whose wrap triggers the FOC step
+     * @param pwm_frequency  PWM frequency of the slice [Hz]
+     * @returns 1 on success, 0 if no software interrupt was available
+     */
+    int init(uint pwm_slice, long pwm_frequency);
+    /**
+     * start running the rate groups - interrupts are taken on the calling core
+     * the controllers and filters of the motor are switched to the fixed sample times of the rate groups
+     */
+    void start();
+    /** stop running the rate groups, the controllers measure their sample time again */
+    void stop();
+    /** clear the execution time and overrun statistics */
+    void resetStats();
+
+    uint16_t foc_divider = SIMPLEFOC_SCHED_FOC_DIVIDER; //!< FOC step every foc_divider PWM periods
+    uint16_t motion_divider = SIMPLEFOC_SCHED_MOTION_DIVIDER; //!< motion step every motion_divider FOC steps
+
+    volatile FOCRateGroupStats foc; //!< FOC rate group statistics
+    volatile FOCRateGroupStats motion; //!< motion rate group statistics
+
+  protected:
+    static void pwmWrapHandler();
+    static void motionHandler();
+    static FOCScheduler* active; //!< scheduler serviced by the interrupt handlers
+
+    /** account one step of a rate group */
+    static void account(volatile FOCRateGroupStats& stats, uint32_t cycles);
+    /** output latency of the FOC step for the latency compensation of the motor */
+    void updateOutputLatency();
+
+    FOCMotor* motor;
+    uint slice = 0; //!< PWM slice triggering the FOC step
+    int motion_irq = -1; //!< software interrupt of the motion step
+    uint32_t cycles_per_pwm = 0; //!< clk_sys cycles per PWM period
+    float pwm_period = 0.0f; //!< PWM period [s]
+    uint16_t pwm_cnt = 0; //!< PWM periods since the last FOC step
+    uint16_t foc_cnt = 0; //!< FOC steps since the last motion step
+    volatile bool motion_busy = false; //!< motion step pending or running
+};
+
+#endif
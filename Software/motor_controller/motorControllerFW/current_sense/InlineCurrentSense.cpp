@@ -41,7 +41,7 @@ int InlineCurrentSense::init(){
     // at least for init()
     void* drv_params = driver ? driver->params : nullptr;
     // configure ADC variables
-    params = _configureADCInline(drv_params,pinA,pinB,pinC);
+    params = _configureADCInline(drv_params,pinA,pinB,pinC,pinVbus);
     // if init failed return fail
     if (params == SIMPLEFOC_CURRENT_SENSE_INIT_FAILED) return 0; 
     // set the center pwm (0 voltage vector)
@@ -80,9 +80,81 @@ void InlineCurrentSense::calibrateOffsets(){
 
 // read all three phase currents (if possible 2 or 3)
 PhaseCurrent_s InlineCurrentSense::getPhaseCurrents(){
+    // all phases and the bus voltage from one conversion
+    const int pins[4] = {pinA, pinB, pinC, pinVbus};
+    float voltages[4];
+    sample_timestamp = _readADCVoltagesInline(pins, voltages, 4, params);
     PhaseCurrent_s current;
-    current.a = (!_isset(pinA)) ? 0 : (_readADCVoltageInline(pinA, params) - offset_ia)*gain_a;// amps
-    current.b = (!_isset(pinB)) ? 0 : (_readADCVoltageInline(pinB, params) - offset_ib)*gain_b;// amps
-    current.c = (!_isset(pinC)) ? 0 : (_readADCVoltageInline(pinC, params) - offset_ic)*gain_c; // amps
+    current.a = (!_isset(pinA)) ? 0 : (voltages[0] - offset_ia)*gain_a;// amps
+    current.b = (!_isset(pinB)) ? 0 : (voltages[1] - offset_ib)*gain_b;// amps
+    current.c = (!_isset(pinC)) ? 0 : (voltages[2] - offset_ic)*gain_c; // amps
+    if(_isset(pinVbus)) vbus_pin_voltage = voltages[3];
+    if(unipolar && driver_type == DriverType::Stepper){
+        int8_t sign_a, sign_b;
+        unipolarSigns(&sign_a, &sign_b);
+        current.a *= sign_a;
+        current.b *= sign_b;
+    }
+    return current;
+}
+
+// fixed point variant - the same conversion without a float operation
+PhaseCurrentQ16_s InlineCurrentSense::getPhaseCurrentsQ16(){
+    // gains and offsets are public floats, their Q16.16 copies are refreshed when the bit patterns change
+    uint32_t bits[4] = {_float_bits(gain_a), _float_bits(gain_b), _float_bits(offset_ia), _float_bits(offset_ib)};
+    if(memcmp(bits, fixed_cache, sizeof(bits))){
+        memcpy(fixed_cache, bits, sizeof(bits));
+        gain_a_q = _float_to_q16(gain_a);
+        gain_b_q = _float_to_q16(gain_b);
+        offset_ia_q = _float_to_q16(offset_ia);
+        offset_ib_q = _float_to_q16(offset_ib);
+    }
+    const int pins[4] = {pinA, pinB, pinC, pinVbus};
+    q16_t voltages[4];
+    sample_timestamp = _readADCVoltagesInlineQ16(pins, voltages, 4, params);
+    PhaseCurrentQ16_s current;
+    current.a = (!_isset(pinA)) ? 0 : _q16_mul(voltages[0] - offset_ia_q, gain_a_q);// amps
+    current.b = (!_isset(pinB)) ? 0 : _q16_mul(voltages[1] - offset_ib_q, gain_b_q);// amps
+    current.c = 0; // the stepper pipeline has two phases
+    // the bus voltage is filtered in float by updateBusVoltage()
+    if(_isset(pinVbus)) vbus_pin_voltage = _q16_to_float(voltages[3]);
+    if(unipolar && driver_type == DriverType::Stepper){
+        int8_t sign_a, sign_b;
+        unipolarSigns(&sign_a, &sign_b);
+        if(sign_a < 0) current.a = -current.a;
+        if(sign_b < 0) current.b = -current.b;
+    }
     return current;
+}
+
+// magnitude only - the sign is the one of the expected current of this step
+// the phase voltage leads the current (inductance, back-emf, the wL decoupling), so the bridge
+// polarity is only the fallback before the motor sets a reference, or while the reference is 0
+void InlineCurrentSense::unipolarSigns(int8_t* sign_a, int8_t* sign_b){
+    StepperDriver* stepper_driver = (StepperDriver*)driver;
+    *sign_a = stepper_driver->polarity_a;
+    *sign_b = stepper_driver->polarity_b;
+    if(!current_reference_set) return;
+    int8_t ref_a = reference_sign_alpha ? reference_sign_alpha : *sign_a;
+    int8_t ref_b = reference_sign_beta ? reference_sign_beta : *sign_b;
+    // how often the voltage polarity would have given the other sign
+    sign_samples++;
+    if(ref_a != *sign_a || ref_b != *sign_b) sign_disagreements++;
+    *sign_a = ref_a;
+    *sign_b = ref_b;
+}
+
+// read and filter the bus voltage
+float InlineCurrentSense::updateBusVoltage(){
+    if(!_isset(pinVbus) || !_isset(vbus_ratio)) return NOT_SET;
+    float voltage;
+    if(sample_timestamp != vbus_timestamp){
+        // new conversion read with the phase currents, use the same one
+        voltage = vbus_pin_voltage;
+        vbus_timestamp = sample_timestamp;
+    }else{
+        voltage = _readADCVoltageInline(pinVbus, params);
+    }
+    bus_voltage = LPF_vbus(voltage*vbus_ratio);
+    return bus_voltage;
 }
\ No newline at end of file
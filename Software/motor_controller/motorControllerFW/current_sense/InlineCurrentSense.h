@@ -35,6 +35,25 @@ class InlineCurrentSense: public CurrentSense{
     // CurrentSense interface implementing functions 
     int init() override;
     PhaseCurrent_s getPhaseCurrents() override;
+    PhaseCurrentQ16_s getPhaseCurrentsQ16() override;
+    float updateBusVoltage() override;
+
+    /**
+     * The sense output only carries the current magnitude (e.g. DRV8251A IPROPI current mirror),
+     * the sign is taken from the expected current set by the motor (setCurrentReference), or from the
+     * polarity the linked stepper driver drives each phase with if there is none
+     */
+    bool unipolar = false;
+    uint32_t sign_samples = 0; //!< unipolar reads signed from the current reference
+    uint32_t sign_disagreements = 0; //!< of those, reads where the driver voltage polarity has a different sign
+
+    int pinVbus = NOT_SET; //!< optional ADC pin converted together with the phases (bus voltage divider), set before init()
+    float vbus_pin_voltage = 0; //!< voltage at pinVbus from the same conversion as the last getPhaseCurrents()
+    unsigned long sample_timestamp = 0; //!< time of the conversion read by the last getPhaseCurrents() [us]
+
+    float vbus_ratio = NOT_SET; //!< bus voltage / voltage at pinVbus (divider ratio), NOT_SET disables the bus voltage measurement
+    LowPassFilter LPF_vbus{DEF_VBUS_FILTER_Tf}; //!< bus voltage low pass filter
+    float bus_voltage = NOT_SET; //!< filtered bus voltage [V], updated by updateBusVoltage()
 
   private:
   
@@ -42,6 +61,17 @@ class InlineCurrentSense: public CurrentSense{
     float shunt_resistor; //!< Shunt resistor value
     float amp_gain; //!< amp gain value
     float volts_to_amps_ratio; //!< Volts to amps ratio
+    unsigned long vbus_timestamp = 0; //!< conversion time of the last filtered bus voltage sample [us]
+
+    /** signs of the unipolar phase A and B magnitudes */
+    void unipolarSigns(int8_t* sign_a, int8_t* sign_b);
+
+    // Q16.16 copies of the gains and offsets for getPhaseCurrentsQ16()
+    uint32_t fixed_cache[4] = {0}; //!< bit patterns of gain_a, gain_b, offset_ia, offset_ib the copies were made from
+    q16_t gain_a_q = 0; //!< phase A gain in Q16.16
+    q16_t gain_b_q = 0; //!< phase B gain in Q16.16
+    q16_t offset_ia_q = 0; //!< phase A offset in Q16.16
+    q16_t offset_ib_q = 0; //!< phase B offset in Q16.16
     
     /**
      *  Function finding zero offsets of the ADC
@@ -24,6 +24,28 @@ typedef struct GenericCurrentSenseParams {
  */
 float _readADCVoltageInline(const int pinA, const void* cs_params);
 
+/**
+ *  function reading several ADC values from the same conversion and returning the read voltages
+ *
+ * @param pins - the arduino pins to be read (they have to be ADC pins)
+ * @param voltages - the read voltages, NAN for pins that are not converted
+ * @param count - number of pins
+ * @param cs_params -current sense parameter structure - hardware specific
+ * @return time of the conversion in microseconds
+ */
+unsigned long _readADCVoltagesInline(const int* pins, float* voltages, int count, const void* cs_params);
+
+/**
+ *  fixed point variant of _readADCVoltagesInline(), for the SIMPLEFOC_FIXED_POINT pipeline
+ *
+ * @param pins - the arduino pins to be read (they have to be ADC pins)
+ * @param voltages - the read voltages in Q16.16, 0 for pins that are not converted
+ * @param count - number of pins
+ * @param cs_params -current sense parameter structure - hardware specific
+ * @return time of the conversion in microseconds
+ */
+unsigned long _readADCVoltagesInlineQ16(const int* pins, q16_t* voltages, int count, const void* cs_params);
+
 /**
  *  function reading an ADC value and returning the read voltage
  *
@@ -31,8 +53,9 @@ float _readADCVoltageInline(const int pinA, const void* cs_params);
  * @param pinA - adc pin A
  * @param pinB - adc pin B
  * @param pinC - adc pin C
+ * @param pinAux - additional adc pin converted with the phases
  */
-void* _configureADCInline(const void *driver_params, const int pinA,const int pinB,const int pinC = NOT_SET);
+void* _configureADCInline(const void *driver_params, const int pinA,const int pinB,const int pinC = NOT_SET, const int pinAux = NOT_SET);
 
 /**
  *  function reading an ADC value and returning the read voltage
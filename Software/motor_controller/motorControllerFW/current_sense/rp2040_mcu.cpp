@@ -4,27 +4,24 @@
 // #include "communication/SimpleFOCDebug.h"
 
 #include "hardware/dma.h"
-#include "hardware/irq.h"
 #include "hardware/pwm.h"
 #include "hardware/adc.h"
+#include "hardware/timer.h"
 
 
 /* Singleton instance of the ADC engine */
 RP2040ADCEngine engine;
 
-alignas(32) const uint32_t trigger_value = ADC_CS_START_ONCE_BITS; // start once
+alignas(32) const uint32_t trigger_value = ADC_CS_START_MANY_BITS; // written to the set alias to start, to the clear alias to stop
 
 /* Hardware API implementation */
 
 float _readADCVoltageInline(const int pinA, const void* cs_params) {
-    // not super-happy with this. Here we have to return 1 phase current at a time, when actually we want to
-    // return readings from the same ADC conversion run. The ADC on RP2040 is anyway in round robin mode :-(
-    // like this we either have to block interrupts, or of course have the chance of reading across
-    // new ADC conversions, which probably won't improve the accuracy.
+    // single channel, use _readADCVoltagesInline() to read several channels from the same frame
     _UNUSED(cs_params);
 
     if (pinA>=26 && pinA<=29 && engine.channelsEnabled[pinA-26]) {
-        return engine.lastResults.raw[pinA-26]*engine.adc_conv;
+        return engine.getLastResult(pinA-26)*engine.adc_conv;
     }
 
     // otherwise return NaN
@@ -32,15 +29,52 @@ float _readADCVoltageInline(const int pinA, const void* cs_params) {
 };
 
 
-void* _configureADCInline(const void *driver_params, const int pinA, const int pinB, const int pinC) {
+unsigned long _readADCVoltagesInline(const int* pins, float* voltages, int count, const void* cs_params) {
+    _UNUSED(cs_params);
+
+    ADCFrame frame = engine.getLastFrame();
+    for (int i = 0; i < count; i++) {
+        int pin = pins[i];
+        if (pin>=26 && pin<=29 && engine.channelsEnabled[pin-26])
+            voltages[i] = frame.results.raw[pin-26]*engine.adc_conv;
+        else
+            voltages[i] = NAN;
+    }
+    return frame.timestamp;
+};
+
+
+unsigned long _readADCVoltagesInlineQ16(const int* pins, q16_t* voltages, int count, const void* cs_params) {
+    _UNUSED(cs_params);
+
+    ADCFrame frame = engine.getLastFrame();
+    for (int i = 0; i < count; i++) {
+        int pin = pins[i];
+        // raw sum x volts per count in Q24, down to Q16 - below 2^32 for the full scale of any oversampling
+        if (pin>=26 && pin<=29 && engine.channelsEnabled[pin-26])
+            voltages[i] = (q16_t)((frame.results.raw[pin-26]*engine.adc_conv_q24) >> 8);
+        else
+            voltages[i] = 0;
+    }
+    return frame.timestamp;
+};
+
+
+void* _configureADCInline(const void *driver_params, const int pinA, const int pinB, const int pinC, const int pinAux) {
     _UNUSED(driver_params);
 
+    if( _isset(pinAux) )
+        engine.addPin(pinAux);
     if( _isset(pinA) )
         engine.addPin(pinA);
     if( _isset(pinB) )
         engine.addPin(pinB);
     if( _isset(pinC) )
         engine.addPin(pinC);
+#if SIMPLEFOC_RP2040_ADC_PWM_TRIGGER
+    if (driver_params)
+        engine.setPWMTrigger(((RP2040DriverParams*)driver_params)->slice[0]);
+#endif
     engine.init(); // TODO this has to happen later if we want to support more than one motor...
     engine.start();
     return &engine;
@@ -88,30 +122,6 @@ void* _configureADCInline(const void *driver_params, const int pinA, const int p
 
 
 
-volatile int rp2040_intcount = 0;
-
-void _adcConversionFinishedHandler() {
-    // conversion of all channels finished. copy results.
-    volatile uint8_t* from = engine.samples;
-    if (engine.channelsEnabled[0])
-        engine.lastResults.raw[0] = (*from++);
-    if (engine.channelsEnabled[1])
-        engine.lastResults.raw[1] = (*from++);
-    if (engine.channelsEnabled[2])
-        engine.lastResults.raw[2] = (*from++);
-    if (engine.channelsEnabled[3])
-        engine.lastResults.raw[3] = (*from++);
-    //dma_channel_acknowledge_irq0(engine.readDMAChannel);
-    dma_hw->ints0 = 1u << engine.readDMAChannel;
-    //dma_start_channel_mask( (1u << engine.readDMAChannel) );
-    dma_channel_set_write_addr(engine.readDMAChannel, engine.samples, true);
-    // if (engine.triggerPWMSlice>=0)
-    //     dma_channel_set_trans_count(engine.triggerDMAChannel, 1, true);
-    rp2040_intcount++;
-};
-
-
-
 /* ADC engine implementation */
 
 
@@ -134,9 +144,9 @@ void RP2040ADCEngine::addPin(int pin) {
 
 
 
-// void RP2040ADCEngine::setPWMTrigger(uint slice){
-//     triggerPWMSlice = slice;
-// };
+void RP2040ADCEngine::setPWMTrigger(uint slice){
+    triggerPWMSlice = slice;
+};
 
 
 
@@ -147,23 +157,31 @@ bool RP2040ADCEngine::init() {
     
     adc_init();
     int enableMask = 0x00;
-    int channelCount = 0;
-    for (int i = 3; i>=0; i--) {
+    channelCount = 0;
+    for (int i = 0; i<4; i++) {
         if (channelsEnabled[i]){
             adc_gpio_init(i+26);
             enableMask |= (0x01<<i);
-            channelCount++;
+            channelPos[i] = channelCount++; // round robin order
         }
     }
     adc_set_round_robin(enableMask);
     adc_fifo_setup(
      true,              // Write each completed conversion to the sample FIFO
      true,              // Enable DMA data request (DREQ)
-     channelCount,      // DREQ (and IRQ) asserted when all samples present
-     false,             // We won't see the ERR bit because of 8 bit reads; disable.
-     true               // Shift each sample to 8 bits when pushing to FIFO
+     1,                 // DREQ asserted for every sample, the DMA counts the conversions
+     false,             // Keep bit 15 clear, the samples are summed
+     false              // Full 12 bit samples
     );
-    if (samples_per_second<1 || samples_per_second>=500000) {
+    if (oversampling < 1)
+        oversampling = (triggerPWMSlice>=0) ? SIMPLEFOC_RP2040_ADC_TRIGGER_OVERSAMPLING : SIMPLEFOC_RP2040_ADC_OVERSAMPLING;
+    oversampling = _constrain(oversampling, 1, SIMPLEFOC_RP2040_ADC_OVERSAMPLING_MAX);
+    adc_conv = SIMPLEFOC_RP2040_ADC_VDDA / SIMPLEFOC_RP2040_ADC_RESOLUTION / oversampling;
+    adc_conv_q24 = (uint32_t)(adc_conv * 16777216.0f);
+    frameLength = channelCount*oversampling;
+    if (triggerPWMSlice>=0)
+        adc_set_clkdiv(SIMPLEFOC_RP2040_ADC_TRIGGER_CLKDIV);
+    else if (samples_per_second<1 || samples_per_second>=500000) {
         samples_per_second = 0;
         adc_set_clkdiv(0);
     }
@@ -171,43 +189,99 @@ bool RP2040ADCEngine::init() {
         adc_set_clkdiv(48000000/samples_per_second);
     // SIMPLEFOC_DEBUG("RP2040-CUR: ADC init");
 
+    // read: one frame from the FIFO, the re-arm channel sets the buffer and starts it
     readDMAChannel = dma_claim_unused_channel(true);
+    rearmDMAChannel = dma_claim_unused_channel(true);
+    frames[0] = samples[0];
+    frames[1] = samples[1];
     dma_channel_config cc1 = dma_channel_get_default_config(readDMAChannel);
-    channel_config_set_transfer_data_size(&cc1, DMA_SIZE_8);
+    channel_config_set_transfer_data_size(&cc1, DMA_SIZE_16);
     channel_config_set_read_increment(&cc1, false);
     channel_config_set_write_increment(&cc1, true);
     channel_config_set_dreq(&cc1, DREQ_ADC);
-    channel_config_set_irq_quiet(&cc1, false);
+    channel_config_set_irq_quiet(&cc1, true);
+    channel_config_set_chain_to(&cc1, rearmDMAChannel);
     dma_channel_configure(readDMAChannel,
         &cc1,
-        samples,        // dest
+        samples[0],     // dest
         &adc_hw->fifo,  // source
-        channelCount,   // count
+        frameLength,    // count
+        false           // defer start
+    );
+    // stamp: copies the timer to the frameTime entry of the frame just completed (write ring of 2 entries)
+    stampDMAChannel = dma_claim_unused_channel(true);
+    dma_channel_config cc5 = dma_channel_get_default_config(stampDMAChannel);
+    channel_config_set_transfer_data_size(&cc5, DMA_SIZE_32);
+    channel_config_set_read_increment(&cc5, false);
+    channel_config_set_write_increment(&cc5, true);
+    channel_config_set_ring(&cc5, true, 3); // 8 byte ring: frameTime[0], frameTime[1], frameTime[0], ...
+    channel_config_set_irq_quiet(&cc5, true);
+    channel_config_set_chain_to(&cc5, rearmDMAChannel);
+    dma_channel_configure(stampDMAChannel,
+        &cc5,
+        frameTime,      // dest
+        &timer_hw->timerawl, // source
+        1,              // count
+        false           // defer start
+    );
+    channel_config_set_chain_to(&cc1, stampDMAChannel);
+    dma_channel_set_config(readDMAChannel, &cc1, false);
+    // re-arm: writes the next buffer from the frames table (read ring of 2 pointers) to the
+    // write address trigger alias of the read channel
+    dma_channel_config cc2 = dma_channel_get_default_config(rearmDMAChannel);
+    channel_config_set_transfer_data_size(&cc2, DMA_SIZE_32);
+    channel_config_set_read_increment(&cc2, true);
+    channel_config_set_write_increment(&cc2, false);
+    channel_config_set_ring(&cc2, false, 3); // 8 byte ring: frames[0], frames[1], frames[0], ...
+    channel_config_set_irq_quiet(&cc2, true);
+    dma_channel_configure(rearmDMAChannel,
+        &cc2,
+        &dma_hw->ch[readDMAChannel].al2_write_addr_trig, // dest
+        frames,         // source
+        1,              // count
         false           // defer start
     );
-    dma_channel_set_irq0_enabled(readDMAChannel, true);
-    irq_add_shared_handler(DMA_IRQ_0, _adcConversionFinishedHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
 
     // SIMPLEFOC_DEBUG("RP2040-CUR: DMA init");
 
-    // if (triggerPWMSlice>=0) { // if we have a trigger
-    //     triggerDMAChannel = dma_claim_unused_channel(true);
-    //     dma_channel_config cc3 = dma_channel_get_default_config(triggerDMAChannel);
-    //     channel_config_set_transfer_data_size(&cc3, DMA_SIZE_32);
-    //     channel_config_set_read_increment(&cc3, false);
-    //     channel_config_set_write_increment(&cc3, false);
-    //     channel_config_set_irq_quiet(&cc3, true);
-    //     channel_config_set_dreq(&cc3, DREQ_PWM_WRAP0+triggerPWMSlice); //pwm_get_dreq(triggerPWMSlice));
-    //     pwm_set_irq_enabled(triggerPWMSlice, true);
-    //     dma_channel_configure(triggerDMAChannel,
-    //         &cc3,
-    //         hw_set_alias_untyped(&adc_hw->cs),    // dest
-    //         &trigger_value, // source
-    //         1,              // count
-    //         true           // defer start
-    //     );
-    //     SIMPLEFOC_DEBUG("RP2040-CUR: PWM trigger init slice ", triggerPWMSlice);
-    // }
+    if (triggerPWMSlice>=0) { // if we have a trigger
+        triggerDMAChannel = dma_claim_unused_channel(true);
+        stopDMAChannel = dma_claim_unused_channel(true);
+        // trigger: one write per PWM wrap
+        dma_channel_config cc3 = dma_channel_get_default_config(triggerDMAChannel);
+        channel_config_set_transfer_data_size(&cc3, DMA_SIZE_32);
+        channel_config_set_read_increment(&cc3, false);
+        channel_config_set_write_increment(&cc3, false);
+        channel_config_set_irq_quiet(&cc3, true);
+        channel_config_set_dreq(&cc3, pwm_get_dreq(triggerPWMSlice));
+        dma_channel_configure(triggerDMAChannel,
+            &cc3,
+            hw_set_alias_untyped(&adc_hw->cs),    // dest
+            &trigger_value, // source
+            1,              // count
+            false           // defer start
+        );
+        // stop: runs as soon as the read channel has all samples, then the re-arm channel
+        dma_channel_config cc4 = dma_channel_get_default_config(stopDMAChannel);
+        channel_config_set_transfer_data_size(&cc4, DMA_SIZE_32);
+        channel_config_set_read_increment(&cc4, false);
+        channel_config_set_write_increment(&cc4, false);
+        channel_config_set_irq_quiet(&cc4, true);
+        channel_config_set_chain_to(&cc4, stampDMAChannel);
+        dma_channel_configure(stopDMAChannel,
+            &cc4,
+            hw_clear_alias_untyped(&adc_hw->cs),  // dest
+            &trigger_value, // source
+            1,              // count
+            false           // defer start
+        );
+        // read -> stop -> stamp -> re-arm -> trigger, which waits for the next wrap
+        channel_config_set_chain_to(&cc1, stopDMAChannel);
+        dma_channel_set_config(readDMAChannel, &cc1, false);
+        channel_config_set_chain_to(&cc2, triggerDMAChannel);
+        dma_channel_set_config(rearmDMAChannel, &cc2, false);
+        // SIMPLEFOC_DEBUG("RP2040-CUR: PWM trigger init slice ", triggerPWMSlice);
+    }
 
     initialized = true;
     return initialized;
@@ -218,20 +292,17 @@ bool RP2040ADCEngine::init() {
 
 void RP2040ADCEngine::start() {
     // SIMPLEFOC_DEBUG("RP2040-CUR: ADC engine starting");
-    irq_set_enabled(DMA_IRQ_0, true);
-    dma_start_channel_mask( (1u << readDMAChannel) );
     for (int i=0;i<4;i++) {
         if (channelsEnabled[i]) {
             adc_select_input(i); // set input to first enabled channel
             break;
         }
     }
-    // if (triggerPWMSlice>=0) {
-    //     dma_start_channel_mask( (1u << triggerDMAChannel) );
-    //     //hw_set_bits(&adc_hw->cs, trigger_value);
-    // }
-    // else
-    adc_run(true);
+    // the re-arm channel starts the read channel on frame 0 (and the trigger channel when triggered)
+    dma_channel_set_write_addr(stampDMAChannel, frameTime, false);
+    dma_channel_set_read_addr(rearmDMAChannel, frames, true);
+    if (triggerPWMSlice<0)
+        adc_run(true);
     // SIMPLEFOC_DEBUG("RP2040-CUR: ADC engine started");
 };
 
@@ -239,19 +310,73 @@ void RP2040ADCEngine::start() {
 
 
 void RP2040ADCEngine::stop() {
+    if (triggerPWMSlice>=0) {
+        dma_channel_abort(triggerDMAChannel);
+        dma_channel_abort(stopDMAChannel);
+    }
     adc_run(false);
-    irq_set_enabled(DMA_IRQ_0, false);
+    dma_channel_abort(rearmDMAChannel);
+    dma_channel_abort(stampDMAChannel);
     dma_channel_abort(readDMAChannel);
-    // if (triggerPWMSlice>=0)
-    //     dma_channel_abort(triggerDMAChannel);
-    adc_fifo_drain();
+    adc_fifo_drain(); // also waits for a triggered conversion still running
     // SIMPLEFOC_DEBUG("RP2040-CUR: ADC engine stopped");
 };
 
 
 
+int RP2040ADCEngine::lastFrame() {
+    // a frame counts as complete once the re-arm channel has moved the read channel to the other
+    // buffer, by then its timestamp is written too
+    uintptr_t addr = dma_hw->ch[readDMAChannel].write_addr;
+    return (addr >= (uintptr_t)samples[1]) ? 0 : 1;
+};
+
+
+
+uint16_t RP2040ADCEngine::sumChannel(int frame, int channel) {
+    // sum the oversampled rounds of the channel
+    volatile uint16_t* from = samples[frame] + channelPos[channel];
+    uint16_t sum = 0;
+    for (int n = 0; n < oversampling; n++, from += channelCount)
+        sum += *from;
+    return sum;
+};
+
+
+
+ADCFrame RP2040ADCEngine::getLastFrame() {
+    // seqlock with the DMA as writer and the frame timestamp as sequence: the copy is good if the read
+    // channel did not move on to the copied buffer (it would have to complete the other one first) and
+    // did not complete the copied buffer again in the meantime
+    ADCFrame f;
+    int frame;
+    do {
+        frame = lastFrame();
+        f.timestamp = frameTime[frame];
+        f.results.value = 0;
+        for (int i = 0; i < 4; i++)
+            if (channelsEnabled[i])
+                f.results.raw[i] = sumChannel(frame, i);
+    } while (lastFrame() != frame || frameTime[frame] != f.timestamp);
+    return f;
+};
+
+
+
+uint16_t RP2040ADCEngine::getLastResult(int channel) {
+    int frame;
+    uint32_t stamp;
+    uint16_t sum;
+    do {
+        frame = lastFrame();
+        stamp = frameTime[frame];
+        sum = sumChannel(frame, channel);
+    } while (lastFrame() != frame || frameTime[frame] != stamp);
+    return sum;
+};
+
+
+
 ADCResults RP2040ADCEngine::getLastResults() {
-    ADCResults r;
-    r.value = lastResults.value;
-    return r;
+    return getLastFrame().results;
 };
\ No newline at end of file
@@ -6,7 +6,7 @@
 /*
  * RP2040 ADC features are very weak :-(
  *  - only 4 inputs
- *  - only 9 bit effective resolution
+ *  - only 9 bit effective resolution (12 bit raw)
  *  - read only 1 input at a time
  *  - 2 microseconds conversion time!
  *  - no triggers from PWM / events, only DMA
@@ -20,11 +20,15 @@
  * 
  * For motor current sensing, the engine supports inline sensing only.
  * 
- * Inline sensing is supported by offering a user-selectable fixed ADC sampling rate, which can be set between 500kHz and 1Hz.
- * After starting the engine it will continuously sample and provide new values at the configured rate.
- * 
- * The default sampling rate is 20kHz, which is suitable for 2 channels assuming you a 5kHz main loop speed (a new measurement is used per
- * main loop iteration).
+ * Inline sensing is triggered from the PWM by default: when the current sense is linked to a driver, one frame of conversions
+ * is started at every wrap of the driver's first PWM slice. The slices run phase correct, so the wrap is the middle of the
+ * on-time of every phase, where the sample sees the mean of the switching ripple. The frame takes
+ * channelCount x oversampling x (SIMPLEFOC_RP2040_ADC_TRIGGER_CLKDIV+1)/48MHz - the channels are converted one after the
+ * other, so only the first round starts at the centre and every later conversion sits further into the ripple. Hence the
+ * triggered default of one round (SIMPLEFOC_RP2040_ADC_TRIGGER_OVERSAMPLING) at close to the fastest conversion rate:
+ * 3 channels take 6.5us, the first at the centre.
+ * Without a driver (or with SIMPLEFOC_RP2040_ADC_PWM_TRIGGER 0) the engine free-runs at a user-selectable fixed ADC sampling rate,
+ * which can be set between 500kHz and 1Hz. The default free-running rate is 20kHz.
  * 
  * Low-side sensing is currently not supported.
  * 
@@ -35,60 +39,110 @@
  * Note that if using other ADC channels along with the motor current sensing, those channels will be subject to the same conversion schedule as the motor's ADC channels, i.e. convert at the same fixed rate in case
  * of inline sensing.
  * 
- * Solution to trigger ADC conversion from PWM via DMA:
- * use the PWM wrap as a DREQ to a DMA channel, and have the DMA channel write to the ADC's CS register to trigger an ADC sample.
- * Unfortunately, I could not get this to work, so no low side sensing for the moment.
+ * Triggering the ADC conversion from the PWM via DMA, without the CPU:
+ *  - trigger channel: paced by the PWM wrap DREQ, sets START_MANY in the ADC's CS register
+ *  - the ADC converts the enabled channels round-robin, one every SIMPLEFOC_RP2040_ADC_TRIGGER_CLKDIV+1 ADC clocks
+ *  - read channel: empties the FIFO once all channels are converted, then chains to
+ *  - stop channel: clears START_MANY before the next conversion starts, then chains to the re-arm channel (see below),
+ *    which chains back to the trigger channel to wait for the next wrap. The round-robin is back at the first channel.
+ * A single START_ONCE per wrap would only convert one channel, hence START_MANY and the stop channel.
  * 
  * Solution for ADC conversion:
- * ADC converts all channels in round-robin mode, and writes to FIFO. FIFO is emptied by a DMA which triggers after N conversions,
- * where N is the number of ADC channels used. So this DMA copies all the values from one round-robin conversion.
+ * ADC converts all channels in round-robin mode, and writes the 12 bit samples to FIFO. FIFO is emptied by a DMA (16 bit transfers)
+ * which finishes after N*oversampling conversions, where N is the number of ADC channels used. So this DMA copies one frame: all the
+ * values of oversampling round-robin conversions. It chains to a re-arm DMA which points it at the other half of a double buffer
+ * and restarts it, so the two channels fill the buffers in turn with no interrupt at all.
+ * Between the two a stamp DMA copies the timer (us) into the frameTime entry of the completed frame.
+ * The reader takes the latest complete frame (the half the read channel is not writing) and sums it per channel. The sum keeps
+ * the extra resolution of the averaging, adc_conv scales it back to volts. getLastFrame() reads all channels of one frame,
+ * retrying if the DMA got to that buffer meanwhile (seqlock with the frame timestamp as sequence).
+ * In triggered mode all oversampling rounds run from one PWM wrap, each round later than the centre of the pulse: oversampling
+ * averages the ripple instead of avoiding it, and N*oversampling conversions have to stay well inside the PWM period.
  * 
  * 
  */
 
 
-#define SIMPLEFOC_RP2040_ADC_RESOLUTION 256
+#define SIMPLEFOC_RP2040_ADC_RESOLUTION 4096
+#define SIMPLEFOC_RP2040_ADC_OVERSAMPLING_MAX 16 // 16 x 12 bit still fits the 16 bit result
+#ifndef SIMPLEFOC_RP2040_ADC_OVERSAMPLING
+#define SIMPLEFOC_RP2040_ADC_OVERSAMPLING 2 //!< default number of round-robin conversions averaged per result, free-running
+#endif
+#ifndef SIMPLEFOC_RP2040_ADC_TRIGGER_OVERSAMPLING
+#define SIMPLEFOC_RP2040_ADC_TRIGGER_OVERSAMPLING 1 //!< default number of round-robin conversions per result when triggered from the PWM
+#endif
+#ifndef SIMPLEFOC_RP2040_ADC_PWM_TRIGGER
+#define SIMPLEFOC_RP2040_ADC_PWM_TRIGGER 1 //!< trigger the conversions from the PWM wrap of the linked driver
+#endif
+#ifndef SIMPLEFOC_RP2040_ADC_TRIGGER_CLKDIV
+#define SIMPLEFOC_RP2040_ADC_TRIGGER_CLKDIV 103 //!< ADC clock divider in triggered mode: the 96 cycle conversion + 8 cycles for the stop channel to act, 2.17us per channel
+#endif
 #ifndef SIMPLEFOC_RP2040_ADC_VDDA 
 #define SIMPLEFOC_RP2040_ADC_VDDA 3.3f
 #endif
 
 
+// per channel sum of the oversampled 12 bit conversions
 union ADCResults {
-    uint32_t value;
-    uint8_t raw[4];
+    uint64_t value;
+    uint16_t raw[4];
     struct {
-        uint8_t ch0;
-        uint8_t ch1;
-        uint8_t ch2;
-        uint8_t ch3;
+        uint16_t ch0;
+        uint16_t ch1;
+        uint16_t ch2;
+        uint16_t ch3;
     };
 };
 
 
+// all channels of one frame
+struct ADCFrame {
+    ADCResults results;
+    uint32_t timestamp; // timer value [us] when the frame completed
+};
+
+
 class RP2040ADCEngine {
 
 public:
     RP2040ADCEngine();
     void addPin(int pin);
-    //void setPWMTrigger(uint slice);
+    void setPWMTrigger(uint slice); // convert once per wrap of the PWM slice instead of free-running, call before init()
 
     bool init();
     void start();
     void stop();
 
-    ADCResults getLastResults(); // TODO find a better API and representation for this
+    int lastFrame(); // index of the latest complete frame in samples
+    uint16_t getLastResult(int channel); // sum of the oversampled conversions of a channel (0-3) in the latest frame
+    ADCFrame getLastFrame(); // all channels of the latest frame, coherent
+    ADCResults getLastResults(); // getLastFrame() without the timestamp
 
     int samples_per_second = 20000; // 20kHz default (assuming 2 shunts and 5kHz loop speed), set to 0 to convert in tight loop
-    float adc_conv = (SIMPLEFOC_RP2040_ADC_VDDA / SIMPLEFOC_RP2040_ADC_RESOLUTION); // conversion from raw ADC to float
+    int oversampling = 0; // round-robin conversions summed per result, 1 to SIMPLEFOC_RP2040_ADC_OVERSAMPLING_MAX, set before init(); 0 selects the default of the mode
+    float adc_conv = (SIMPLEFOC_RP2040_ADC_VDDA / SIMPLEFOC_RP2040_ADC_RESOLUTION / SIMPLEFOC_RP2040_ADC_OVERSAMPLING); // conversion from raw ADC sum to float, updated by init()
+    uint32_t adc_conv_q24 = (uint32_t)(SIMPLEFOC_RP2040_ADC_VDDA / SIMPLEFOC_RP2040_ADC_RESOLUTION / SIMPLEFOC_RP2040_ADC_OVERSAMPLING * 16777216.0f); // adc_conv in Q24, updated by init()
 
-    //int triggerPWMSlice = -1;
+    int triggerPWMSlice = -1; // PWM slice triggering the conversions, -1 to free-run at samples_per_second
     bool initialized;
     uint readDMAChannel;
-    //uint copyDMAChannel;
-    //uint triggerDMAChannel;
+    uint rearmDMAChannel;
+    uint stampDMAChannel;
+    uint triggerDMAChannel;
+    uint stopDMAChannel;
 
     bool channelsEnabled[4];
-    volatile uint8_t samples[4];
-    volatile ADCResults lastResults;
-    //alignas(32) volatile uint8_t nextResults[4];
-};
\ No newline at end of file
+    int channelCount = 0;
+    uint8_t channelPos[4]; // position of each enabled channel within a round-robin conversion
+    int frameLength = 0; // samples per frame, channelCount*oversampling
+    volatile uint16_t samples[2][4*SIMPLEFOC_RP2040_ADC_OVERSAMPLING_MAX]; // double buffer, one frame each
+    alignas(8) volatile uint16_t* frames[2]; // buffer table read by the re-arm channel, aligned for its ring
+    alignas(8) volatile uint32_t frameTime[2]; // completion timestamps written by the stamp channel, aligned for its ring
+
+protected:
+    uint16_t sumChannel(int frame, int channel); // sum of the oversampled conversions of a channel in a frame
+};
+
+
+/* Singleton instance of the ADC engine, shared by the current sense and the other ADC channels */
+extern RP2040ADCEngine engine;
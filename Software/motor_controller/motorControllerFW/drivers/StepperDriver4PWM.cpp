@@ -80,6 +80,9 @@ void StepperDriver4PWM::setPwm(float Ualpha, float Ubeta) {
     // limit the voltage in driver
     Ualpha = _constrain(Ualpha, -voltage_limit, voltage_limit);
     Ubeta = _constrain(Ubeta, -voltage_limit, voltage_limit);
+    // at exactly 0V the current decays in the direction it had, the previous polarity is kept
+    if( Ualpha != 0 ) polarity_a = Ualpha > 0 ? 1 : -1;
+    if( Ubeta != 0 ) polarity_b = Ubeta > 0 ? 1 : -1;
     // hardware specific writing
     if( Ualpha > 0 )
         duty_cycle1B = _constrain(abs(Ualpha)/voltage_power_supply,0.0f,1.0f);
@@ -92,4 +95,43 @@ void StepperDriver4PWM::setPwm(float Ualpha, float Ubeta) {
         duty_cycle2A = _constrain(abs(Ubeta)/voltage_power_supply,0.0f,1.0f);
     // write to hardware
     _writeDutyCycle4PWM(duty_cycle1A, duty_cycle1B, duty_cycle2A, duty_cycle2B, params);
-}
\ No newline at end of file
+}
+
+
+// Set voltage to the pwm pin - fixed point variant
+void StepperDriver4PWM::setPwmQ16(q16_t Ualpha, q16_t Ubeta) {
+    // the measured VBUS changes every tick, the 64 bit division is only redone when it moved by more
+    // than 1/2^SUPPLY_RECIP_THRESHOLD_SHIFT - the duty cycle error stays below that fraction
+    // the public floats are compared by their bit patterns, the threshold in Q16.16
+    uint32_t supply_bits = _float_bits(voltage_power_supply);
+    if( supply_bits != voltage_power_supply_cache ){
+        voltage_power_supply_cache = supply_bits;
+        q16_t supply_q = _float_to_q16(voltage_power_supply);
+        if( abs(supply_q - supply_recip_from_q) > (supply_recip_from_q >> SUPPLY_RECIP_THRESHOLD_SHIFT) ){
+            supply_recip_from_q = supply_q;
+            supply_recip_q = (supply_q > _Q16_ONE) ? (uint32_t)(((uint64_t)1 << 48) / (uint32_t)supply_q) : 0xFFFFFFFFu;
+        }
+    }
+    if( _float_bits(voltage_limit) != voltage_limit_cache ){
+        voltage_limit_cache = _float_bits(voltage_limit);
+        voltage_limit_q = _float_to_q16(voltage_limit);
+    }
+    uint32_t duty_cycle1A(0),duty_cycle1B(0),duty_cycle2A(0),duty_cycle2B(0);
+    // limit the voltage in driver
+    Ualpha = _constrain(Ualpha, -voltage_limit_q, voltage_limit_q);
+    Ubeta = _constrain(Ubeta, -voltage_limit_q, voltage_limit_q);
+    // |U|/voltage_power_supply in Q16
+    uint32_t dc_alpha = _constrain( ((uint64_t)abs(Ualpha) * supply_recip_q) >> 32, 0, _Q16_ONE);
+    uint32_t dc_beta = _constrain( ((uint64_t)abs(Ubeta) * supply_recip_q) >> 32, 0, _Q16_ONE);
+    // at exactly 0V the current decays in the direction it had, the previous polarity is kept
+    if( Ualpha != 0 ) polarity_a = Ualpha > 0 ? 1 : -1;
+    if( Ubeta != 0 ) polarity_b = Ubeta > 0 ? 1 : -1;
+    // hardware specific writing
+    if( Ualpha > 0 ) duty_cycle1B = dc_alpha;
+    else duty_cycle1A = dc_alpha;
+
+    if( Ubeta > 0 ) duty_cycle2B = dc_beta;
+    else duty_cycle2A = dc_beta;
+    // write to hardware
+    _writeDutyCycle4PWM_q16(duty_cycle1A, duty_cycle1B, duty_cycle2A, duty_cycle2B, params);
+}
@@ -8,6 +8,9 @@
 
 #include "pico/stdlib.h"
 
+// relative supply voltage change that refreshes the fixed point duty cycle scale, 1/256 ~ 0.4%
+#define SUPPLY_RECIP_THRESHOLD_SHIFT 8
+
 /**
  4 pwm stepper driver class
 */
@@ -48,6 +51,14 @@ class StepperDriver4PWM: public StepperDriver
     */
     void setPwm(float Ua, float Ub) override;
 
+    /** 
+     * Set phase voltages to the harware, fixed point variant
+     * 
+     * @param Ua phase A voltage in Q16.16
+     * @param Ub phase B voltage in Q16.16
+    */
+    void setPwmQ16(q16_t Ua, q16_t Ub) override;
+
 
     /** 
      * Set phase voltages to the hardware. 
@@ -59,7 +70,12 @@ class StepperDriver4PWM: public StepperDriver
     virtual void setPhaseState(PhaseState sa, PhaseState sb) override;
 
   private:
-        
+    // fixed point duty cycle scaling, refreshed when the supply voltage moves or the limit changes
+    uint32_t voltage_power_supply_cache = 0; //!< bit pattern of the supply voltage last seen
+    uint32_t voltage_limit_cache = 0; //!< bit pattern of the voltage limit the fixed point limit was computed from
+    q16_t supply_recip_from_q = 0; //!< supply voltage in Q16.16 supply_recip_q was computed from
+    uint32_t supply_recip_q = 0; //!< 2^48/voltage_power_supply(Q16.16) - |U|*supply_recip_q >> 32 is the Q16 duty cycle
+    q16_t voltage_limit_q = 0; //!< voltage limit in Q16.16
 };
 
 
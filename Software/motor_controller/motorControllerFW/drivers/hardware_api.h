@@ -157,6 +157,19 @@ void _writeDutyCycle3PWM(float dc_a,  float dc_b, float dc_c, void* params);
  */ 
 void _writeDutyCycle4PWM(float dc_1a,  float dc_1b, float dc_2a, float dc_2b, void* params);
 
+/** 
+ * Function setting the duty cycle to the pwm pin - fixed point variant
+ * - Stepper driver - 4PWM setting
+ * - hardware specific
+ * 
+ * @param dc_1a  duty cycle phase 1A [0, 65536] (Q16)
+ * @param dc_1b  duty cycle phase 1B [0, 65536] (Q16)
+ * @param dc_2a  duty cycle phase 2A [0, 65536] (Q16)
+ * @param dc_2b  duty cycle phase 2B [0, 65536] (Q16)
+ * @param params  the driver parameters
+ */ 
+void _writeDutyCycle4PWM_q16(uint32_t dc_1a, uint32_t dc_1b, uint32_t dc_2a, uint32_t dc_2b, void* params);
+
 
 /** 
  * Function setting the duty cycle to the pwm pin (ex. analogWrite())
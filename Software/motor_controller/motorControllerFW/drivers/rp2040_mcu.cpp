@@ -197,6 +197,21 @@
      writeDutyCycle(dc_2b, ((RP2040DriverParams*)params)->slice[3], ((RP2040DriverParams*)params)->chan[3]);
  }
  
+ void writeDutyCycleQ16(uint32_t val, uint slice, uint chan) {
+    // val is at most 65536, clamp one count short so (wrap+1)*val stays in 32 bits
+    if (val > 0xFFFF) val = 0xFFFF;
+    pwm_set_chan_level(slice, chan, ((wrapvalues[slice]+1) * val) >> 16);
+ }
+
+
+
+ void _writeDutyCycle4PWM_q16(uint32_t dc_1a, uint32_t dc_1b, uint32_t dc_2a, uint32_t dc_2b, void* params) {
+     writeDutyCycleQ16(dc_1a, ((RP2040DriverParams*)params)->slice[0], ((RP2040DriverParams*)params)->chan[0]);
+     writeDutyCycleQ16(dc_1b, ((RP2040DriverParams*)params)->slice[1], ((RP2040DriverParams*)params)->chan[1]);
+     writeDutyCycleQ16(dc_2a, ((RP2040DriverParams*)params)->slice[2], ((RP2040DriverParams*)params)->chan[2]);
+     writeDutyCycleQ16(dc_2b, ((RP2040DriverParams*)params)->slice[3], ((RP2040DriverParams*)params)->chan[3]);
+ }
+ 
  inline float swDti(float val, float dt) {
      float ret = dt+val;
      if (ret>1.0) ret = 1.0f;
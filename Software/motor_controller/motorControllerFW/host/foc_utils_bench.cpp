@@ -0,0 +1,429 @@
+// Host benchmark and accuracy harness for the common/foc_utils.cpp kernels
+//
+// For every kernel it measures the throughput (ns per call on the host) and sweeps the
+// input range comparing against libm in double precision, reporting max and RMS error.
+// The report is written as JSON so it can be kept as a regression baseline
+// when a kernel is replaced.
+//
+// The RP2040 overrides of _sincos and _sincos_q15 (common/foc_utils_rp2040.cpp), which replace the
+// weak versions on the target, are compiled here as well, on the interpolator model of host/rp2040_model:
+// same lane setup, same 321 entry int16 table, so their accuracy is checked on the code that runs on
+// the target (the *_rp2040 kernels; their ns per call is the model's, not the SIO's). The table itself
+// is checked against round(32768 sin) - the report gives its max deviation in LSB.
+//
+// The velocity mode compares the velocity estimators on a synthetic 14 bit encoder trajectory:
+// the firmware path (angle difference in the motion loop + LowPassFilter) against the PLL
+// estimator and the load torque observer (without and with the true acceleration as model input)
+// at several bandwidths, reporting tracking error, noise and lag.
+//
+// usage: foc_utils_bench [report.json]            (prints to stdout if no file is given)
+//        foc_utils_bench velocity [report.json]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "common/foc_utils.h"
+#include "common/pll_velocity_estimator.h"
+#include "common/load_torque_observer.h"
+
+// the RP2040 overrides, on the host model of interp1 (hardware/interp.h from host/rp2040_model)
+namespace rp2040 {
+#include "common/foc_utils_rp2040.cpp"
+}
+
+#define BENCH_CALLS 10000000
+#define BENCH_INPUTS 4096
+#define SWEEP_STEPS 200000
+
+struct KernelReport {
+  const char* name;
+  const char* error_unit;
+  double ns_per_call;
+  double max_err;
+  double rms_err;
+  long samples;
+};
+
+// accumulates the error statistics of one sweep
+struct ErrorStats {
+  double max_err = 0;
+  double sum_sq = 0;
+  long n = 0;
+  void add(double e) {
+    e = fabs(e);
+    if (e > max_err) max_err = e;
+    sum_sq += e * e;
+    n++;
+  }
+  double rms() const { return n ? sqrt(sum_sq / n) : 0; }
+};
+
+// sink to keep the benchmarked calls from being optimised away
+static volatile float sink;
+
+// time BENCH_CALLS calls of fn over a table of inputs
+template <typename F>
+static double benchmark(const std::vector<float>& in, F fn) {
+  float acc = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < BENCH_CALLS; i++) acc += fn(in[i & (BENCH_INPUTS - 1)]);
+  auto t1 = std::chrono::steady_clock::now();
+  sink = acc;
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / BENCH_CALLS;
+}
+
+// inputs spread evenly over [lo, hi)
+static std::vector<float> inputs(float lo, float hi) {
+  std::vector<float> v(BENCH_INPUTS);
+  for (int i = 0; i < BENCH_INPUTS; i++) v[i] = lo + (hi - lo) * i / BENCH_INPUTS;
+  return v;
+}
+
+// distance between two angles on the circle
+static double angle_diff(double a, double b) {
+  double d = fmod(a - b, 2 * M_PI);
+  if (d > M_PI) d -= 2 * M_PI;
+  if (d < -M_PI) d += 2 * M_PI;
+  return d;
+}
+
+static KernelReport report_sin() {
+  ErrorStats st;
+  for (long i = 0; i < SWEEP_STEPS; i++) {
+    double a = 2 * M_PI * i / SWEEP_STEPS;
+    st.add(_sin((float)a) - sin(a));
+  }
+  double ns = benchmark(inputs(0, _2PI), [](float a) { return _sin(a); });
+  return {"_sin", "abs", ns, st.max_err, st.rms(), st.n};
+}
+
+static KernelReport report_cos() {
+  ErrorStats st;
+  for (long i = 0; i < SWEEP_STEPS; i++) {
+    double a = 2 * M_PI * i / SWEEP_STEPS;
+    st.add(_cos((float)a) - cos(a));
+  }
+  double ns = benchmark(inputs(0, _2PI), [](float a) { return _cos(a); });
+  return {"_cos", "abs", ns, st.max_err, st.rms(), st.n};
+}
+
+static KernelReport report_sincos() {
+  ErrorStats st;
+  for (long i = 0; i < SWEEP_STEPS; i++) {
+    double a = 2 * M_PI * i / SWEEP_STEPS;
+    float s, c;
+    _sincos((float)a, &s, &c);
+    st.add(s - sin(a));
+    st.add(c - cos(a));
+  }
+  double ns = benchmark(inputs(0, _2PI), [](float a) { float s, c; _sincos(a, &s, &c); return s + c; });
+  return {"_sincos", "abs", ns, st.max_err, st.rms(), st.n};
+}
+
+static KernelReport report_sincos_q15() {
+  ErrorStats st;
+  for (long i = 0; i < SWEEP_STEPS; i++) {
+    uint32_t angle = (uint32_t)((4294967296.0 * i) / SWEEP_STEPS);
+    double a = 2 * M_PI * angle / 4294967296.0;
+    q15_t s, c;
+    _sincos_q15(angle, &s, &c);
+    st.add(s / 32768.0 - sin(a));
+    st.add(c / 32768.0 - cos(a));
+  }
+  double ns = benchmark(inputs(0, 1), [](float f) {
+    q15_t s, c;
+    _sincos_q15((uint32_t)(f * 4294967295.0f), &s, &c);
+    return (float)(s + c);
+  });
+  return {"_sincos_q15", "abs", ns, st.max_err, st.rms(), st.n};
+}
+
+static KernelReport report_sincos_rp2040() {
+  ErrorStats st;
+  for (long i = 0; i < SWEEP_STEPS; i++) {
+    double a = 2 * M_PI * i / SWEEP_STEPS;
+    float s, c;
+    rp2040::_sincos((float)a, &s, &c);
+    st.add(s - sin(a));
+    st.add(c - cos(a));
+  }
+  double ns = benchmark(inputs(0, _2PI), [](float a) { float s, c; rp2040::_sincos(a, &s, &c); return s + c; });
+  return {"_sincos_rp2040", "abs", ns, st.max_err, st.rms(), st.n};
+}
+
+static KernelReport report_sincos_q15_rp2040() {
+  ErrorStats st;
+  for (long i = 0; i < SWEEP_STEPS; i++) {
+    uint32_t angle = (uint32_t)((4294967296.0 * i) / SWEEP_STEPS);
+    double a = 2 * M_PI * angle / 4294967296.0;
+    q15_t s, c;
+    rp2040::_sincos_q15(angle, &s, &c);
+    st.add(s / 32768.0 - sin(a));
+    st.add(c / 32768.0 - cos(a));
+  }
+  double ns = benchmark(inputs(0, 1), [](float f) {
+    q15_t s, c;
+    rp2040::_sincos_q15((uint32_t)(f * 4294967295.0f), &s, &c);
+    return (float)(s + c);
+  });
+  return {"_sincos_q15_rp2040", "abs", ns, st.max_err, st.rms(), st.n};
+}
+
+// max deviation of sine_table_full from round(32768 sin), clipped to int16 [LSB]
+static double sine_table_full_error() {
+  const int n = sizeof(rp2040::sine_table_full) / sizeof(rp2040::sine_table_full[0]);
+  double max_err = 0;
+  for (int i = 0; i < n; i++) {
+    double ref = fmin(fmax(round(32768 * sin(2 * M_PI * i / 256)), -32768), 32767);
+    max_err = fmax(max_err, fabs(rp2040::sine_table_full[i] - ref));
+  }
+  return max_err;
+}
+
+static KernelReport report_atan2() {
+  ErrorStats st;
+  const double radius[] = {1e-3, 1.0, 1e3};
+  for (double r : radius) {
+    for (long i = 0; i < SWEEP_STEPS / 3; i++) {
+      double a = -M_PI + 2 * M_PI * (i + 0.5) / (SWEEP_STEPS / 3);
+      float y = (float)(r * sin(a)), x = (float)(r * cos(a));
+      st.add(angle_diff(_atan2(y, x), atan2((double)y, (double)x)));
+    }
+  }
+  double ns = benchmark(inputs(-_PI, _PI), [](float a) { return _atan2(a, 1.0f - a); });
+  return {"_atan2", "rad", ns, st.max_err, st.rms(), st.n};
+}
+
+static KernelReport report_sqrt() {
+  ErrorStats st;
+  // relative error over 1e-4 .. 1e4
+  for (long i = 0; i < SWEEP_STEPS; i++) {
+    double v = pow(10.0, -4.0 + 8.0 * i / SWEEP_STEPS);
+    st.add((_sqrtApprox((float)v) - sqrt(v)) / sqrt(v));
+  }
+  double ns = benchmark(inputs(1e-3f, 1e3f), [](float v) { return _sqrtApprox(v); });
+  return {"_sqrtApprox", "rel", ns, st.max_err, st.rms(), st.n};
+}
+
+static KernelReport report_normalize() {
+  ErrorStats st;
+  // multi-turn angles, the error is measured on the circle so 0 and 2PI are the same angle
+  for (long i = 0; i < SWEEP_STEPS; i++) {
+    double a = -1000.0 + 2000.0 * i / SWEEP_STEPS;
+    float n = _normalizeAngle((float)a);
+    double ref = fmod((double)(float)a, 2 * M_PI);
+    if (ref < 0) ref += 2 * M_PI;
+    // output has to be in range as well
+    if (n < 0 || n > _2PI) st.add(2 * M_PI);
+    else st.add(angle_diff(n, ref));
+  }
+  double ns = benchmark(inputs(-1000, 1000), [](float a) { return _normalizeAngle(a); });
+  return {"_normalizeAngle", "rad", ns, st.max_err, st.rms(), st.n};
+}
+
+// synthetic trajectory of the velocity comparison
+#define VEL_FOC_TS 500e-6 // loopFOC period, the PLL runs here [s]
+#define VEL_MOTION_DIVIDER 10 // move() every N FOC steps, the angle difference + LPF run here
+#define VEL_LPF_TF 0.005 // LPF_velocity.Tf of the firmware
+#define VEL_ENCODER_BITS 14 // MT6701 resolution
+#define VEL_NOISE_LSB 1.0 // angle noise [LSB rms]
+#define VEL_DURATION 9.0 // [s]
+
+// true velocity [rad/s]: ramp up, hold, 2Hz sine on top, ramp down, stop
+static double true_velocity(double t) {
+  if (t < 1) return 20 * t;
+  if (t < 3) return 20;
+  if (t < 7) return 20 + 5 * sin(4 * M_PI * (t - 3));
+  if (t < 8) return 20 * (8 - t);
+  return 0;
+}
+
+// true acceleration [rad/s^2], derivative of true_velocity
+static double true_acceleration(double t) {
+  if (t < 1) return 20;
+  if (t < 3) return 0;
+  if (t < 7) return 20 * M_PI * cos(4 * M_PI * (t - 3));
+  if (t < 8) return -20;
+  return 0;
+}
+
+// true angle [rad], integral of true_velocity
+static double true_angle(double t) {
+  if (t < 1) return 10 * t * t;
+  if (t < 3) return 10 + 20 * (t - 1);
+  if (t < 7) return 50 + 20 * (t - 3) + 5 / (4 * M_PI) * (1 - cos(4 * M_PI * (t - 3)));
+  if (t < 8) return 130 + 20 * (t - 7) - 10 * (t - 7) * (t - 7);
+  return 140;
+}
+
+// deterministic gaussian noise
+static double gauss(uint64_t& state) {
+  auto uniform = [&state]() {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return ((state >> 11) + 0.5) / 9007199254740992.0;
+  };
+  double u1 = uniform(), u2 = uniform();
+  return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+struct VelocityReport {
+  char name[32];
+  double rms_err; // tracking error over the whole trajectory [rad/s]
+  double noise_rms; // error around its mean at constant velocity [rad/s]
+  double lag_ms; // delay best aligning the estimate with the true velocity on the sine [ms]
+};
+
+// estimates sampled at the motion steps
+static VelocityReport velocity_metrics(const char* name, const std::vector<double>& t, const std::vector<double>& est) {
+  VelocityReport r;
+  snprintf(r.name, sizeof(r.name), "%s", name);
+  ErrorStats all;
+  double mean = 0, sq = 0;
+  long n = 0;
+  for (size_t i = 0; i < t.size(); i++) {
+    double e = est[i] - true_velocity(t[i]);
+    all.add(e);
+    if (t[i] > 1.5 && t[i] < 3) { mean += e; sq += e * e; n++; }
+  }
+  mean /= n;
+  r.rms_err = all.rms();
+  r.noise_rms = sqrt(sq / n - mean * mean);
+  double best = 1e30;
+  r.lag_ms = 0;
+  for (double d = 0; d <= 0.05; d += 0.0001) {
+    double s = 0;
+    for (size_t i = 0; i < t.size(); i++) {
+      if (t[i] < 3.5 || t[i] > 6.5) continue;
+      double e = est[i] - true_velocity(t[i] - d);
+      s += e * e;
+    }
+    if (s < best) { best = s; r.lag_ms = d * 1000; }
+  }
+  return r;
+}
+
+static int velocity_mode(FILE* out) {
+  const double counts = 1 << VEL_ENCODER_BITS;
+  const float bandwidths[] = {100, 200, 400, 600};
+  const int n_pll = sizeof(bandwidths) / sizeof(bandwidths[0]);
+  std::vector<PLLVelocityEstimator> plls;
+  std::vector<LoadTorqueObserver> observers, observers_model;
+  for (int i = 0; i < n_pll; i++) {
+    plls.emplace_back(bandwidths[i]);
+    observers.emplace_back(bandwidths[i]);
+    observers_model.emplace_back(bandwidths[i]);
+  }
+
+  std::vector<double> t_motion, lpf_est;
+  std::vector<std::vector<double>> pll_est(n_pll), obs_est(n_pll), obs_model_est(n_pll);
+  uint64_t rng = 1;
+  int64_t angle_prev = 0;
+  double lpf_y = 0;
+  long steps = (long)(VEL_DURATION / VEL_FOC_TS);
+  for (long k = 0; k <= steps; k++) {
+    double t = k * VEL_FOC_TS;
+    // quantized noisy sensor reading as a multi-turn binary angle
+    double turns = true_angle(t) / (2 * M_PI);
+    double count = floor(turns * counts + VEL_NOISE_LSB * gauss(rng));
+    int64_t angle = (int64_t)count << (32 - VEL_ENCODER_BITS);
+
+    for (int i = 0; i < n_pll; i++) {
+      plls[i].update(angle, k ? VEL_FOC_TS : 0);
+      observers[i].update(angle, k ? VEL_FOC_TS : 0);
+      // the model input is applied over the coming period
+      observers_model[i].acceleration_input = true_acceleration(t);
+      observers_model[i].update(angle, k ? VEL_FOC_TS : 0);
+    }
+
+    if (k % VEL_MOTION_DIVIDER) continue;
+    // firmware path: Sensor::getVelocity() over one motion period, then LowPassFilter
+    double Ts = VEL_FOC_TS * VEL_MOTION_DIVIDER;
+    double vel = k ? (angle - angle_prev) * (2 * M_PI / 4294967296.0) / Ts : 0;
+    angle_prev = angle;
+    double alpha = VEL_LPF_TF / (VEL_LPF_TF + Ts);
+    lpf_y = alpha * lpf_y + (1 - alpha) * vel;
+
+    t_motion.push_back(t);
+    lpf_est.push_back(lpf_y);
+    for (int i = 0; i < n_pll; i++) {
+      pll_est[i].push_back(plls[i].velocity);
+      obs_est[i].push_back(observers[i].velocity);
+      obs_model_est[i].push_back(observers_model[i].velocity);
+    }
+  }
+
+  std::vector<VelocityReport> reports;
+  reports.push_back(velocity_metrics("derivative_lpf", t_motion, lpf_est));
+  for (int i = 0; i < n_pll; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "pll_%.0f", bandwidths[i]);
+    reports.push_back(velocity_metrics(name, t_motion, pll_est[i]));
+  }
+  for (int i = 0; i < n_pll; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "observer_%.0f", bandwidths[i]);
+    reports.push_back(velocity_metrics(name, t_motion, obs_est[i]));
+    snprintf(name, sizeof(name), "observer_model_%.0f", bandwidths[i]);
+    reports.push_back(velocity_metrics(name, t_motion, obs_model_est[i]));
+  }
+
+  fprintf(out, "{\n  \"foc_ts\": %g,\n  \"motion_divider\": %d,\n  \"lpf_tf\": %g,\n  \"encoder_bits\": %d,\n  \"noise_lsb\": %g,\n  \"estimators\": [\n",
+          VEL_FOC_TS, VEL_MOTION_DIVIDER, VEL_LPF_TF, VEL_ENCODER_BITS, VEL_NOISE_LSB);
+  for (size_t i = 0; i < reports.size(); i++) {
+    const VelocityReport& r = reports[i];
+    fprintf(out, "    {\"name\": \"%s\", \"rms_err\": %.4f, \"noise_rms\": %.4f, \"lag_ms\": %.1f}%s\n",
+            r.name, r.rms_err, r.noise_rms, r.lag_ms, i < reports.size() - 1 ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  bool velocity = argc > 1 && strcmp(argv[1], "velocity") == 0;
+  if (velocity) {
+    argc--;
+    argv++;
+  }
+
+  FILE* out = stdout;
+  if (argc > 1) {
+    out = fopen(argv[1], "w");
+    if (!out) {
+      fprintf(stderr, "can not open %s\n", argv[1]);
+      return 1;
+    }
+  }
+
+  if (velocity) {
+    int rc = velocity_mode(out);
+    if (out != stdout) fclose(out);
+    return rc;
+  }
+
+  KernelReport reports[] = {
+    report_sin(),
+    report_cos(),
+    report_sincos(),
+    report_sincos_q15(),
+    report_sincos_rp2040(),
+    report_sincos_q15_rp2040(),
+    report_atan2(),
+    report_sqrt(),
+    report_normalize(),
+  };
+
+  fprintf(out, "{\n  \"bench_calls\": %d,\n  \"sweep_steps\": %d,\n  \"sine_table_full\": {\"entries\": %d, \"max_err_lsb\": %.0f},\n  \"kernels\": [\n",
+          BENCH_CALLS, SWEEP_STEPS, (int)(sizeof(rp2040::sine_table_full) / sizeof(rp2040::sine_table_full[0])), sine_table_full_error());
+  int n = sizeof(reports) / sizeof(reports[0]);
+  for (int i = 0; i < n; i++) {
+    const KernelReport& r = reports[i];
+    fprintf(out, "    {\"name\": \"%s\", \"ns_per_call\": %.3f, \"error_unit\": \"%s\", \"max_err\": %.3e, \"rms_err\": %.3e, \"samples\": %ld}%s\n",
+            r.name, r.ns_per_call, r.error_unit, r.max_err, r.rms_err, r.samples, i < n - 1 ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  if (out != stdout) fclose(out);
+  return 0;
+}
@@ -0,0 +1,216 @@
+// Host equivalence test and benchmark of the SIMPLEFOC_FIXED_POINT controllers
+//
+// common/pid.cpp and common/lowpass_filter.cpp are compiled twice into this file, once per
+// arithmetic (namespaces pid_float and pid_fixed), and driven with the same error sequences:
+// the current, velocity and angle loop gains of the firmware, an integral gain above the old
+// 32 bit limit of the fixed point path, and the measured sample time mode with jittered calls.
+// For every case it reports the max output difference against the float version, checks it
+// against the bound of the case and measures ns per call of both versions.
+//
+// The timing is a host figure - the host has an FPU, so it shows the cost of the integer path
+// itself (ns_q16, stepQ16/filterQ16 as called by the fixed point current loop) and with the
+// float<->Q16.16 conversions at its interface (ns_fixed), not the soft-float cost of the RP2040.
+// The target figures are printed at boot by printFixedPointTiming() (common/fixed_point_bench.cpp).
+//
+// usage: pid_fixed_bench [report.json]            (prints to stdout if no file is given)
+// returns 1 if any case is out of its bound
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// the system headers have to be included outside of the namespaces
+#include "common/foc_utils.h"
+#include "common/defaults.h"
+
+static uint64_t host_time_us = 0;
+uint64_t time_us_64() { return host_time_us; }
+
+namespace pid_float {
+#include "common/pid.cpp"
+#include "common/lowpass_filter.cpp"
+}
+
+#undef PID_H
+#undef LOWPASS_FILTER_H
+#undef SIMPLEFOC_FIXED_POINT
+#define SIMPLEFOC_FIXED_POINT 1
+
+namespace pid_fixed {
+#include "common/pid.cpp"
+#include "common/lowpass_filter.cpp"
+}
+
+#define STEPS 200000
+#define BENCH_CALLS 10000000
+#define BENCH_INPUTS 4096
+
+struct PidCase {
+  const char* name;
+  float P, I, D, ramp, limit;
+  float Ts;          //!< fixed sample time [s], 0 for the measured mode
+  float error_amp;   //!< amplitude of the error sequence
+  double bound;      //!< max allowed |fixed - float| of the output
+};
+
+struct LpfCase {
+  const char* name;
+  float Tf;
+  float Ts;
+  float amp;
+  double bound;
+};
+
+struct Report {
+  const char* name;
+  double max_err;
+  double rms_err;
+  double bound;
+  double ns_float;
+  double ns_fixed;
+  double ns_q16;
+};
+
+// deterministic error sequence: random walk with steps, so that the integral saturates,
+// the ramp limits and the derivative sees jumps
+static std::vector<float> error_sequence(float amp, unsigned seed) {
+  std::vector<float> e(STEPS);
+  uint32_t s = seed;
+  auto rnd = [&s]() { s = s * 1664525u + 1013904223u; return (s >> 8) * (1.0f / 16777216.0f) - 0.5f; };
+  float walk = 0;
+  for (int i = 0; i < STEPS; i++) {
+    walk += 0.02f * amp * rnd();
+    walk = _constrain(walk, -amp, amp);
+    if (i % 5000 == 0) walk = amp * 2.0f * rnd();
+    e[i] = walk + 0.01f * amp * rnd();
+  }
+  return e;
+}
+
+// call interval of the measured mode, jittered around Ts
+static uint32_t next_dt_us(int i) {
+  return 500 + (uint32_t)((i * 2654435761u) >> 27);
+}
+
+static volatile float sink;
+
+template <typename C>
+static double benchmark(C& c, const std::vector<float>& in) {
+  float acc = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < BENCH_CALLS; i++) acc += c(in[i & (BENCH_INPUTS - 1)]);
+  auto t1 = std::chrono::steady_clock::now();
+  sink = acc;
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / BENCH_CALLS;
+}
+
+// the Q16.16 entry point F of the fixed point version, without the conversions
+template <typename C, typename F>
+static double benchmark_q16(C& c, F step, const std::vector<float>& in) {
+  std::vector<q16_t> in_q(in.size());
+  for (size_t i = 0; i < in.size(); i++) in_q[i] = _float_to_q16(in[i]);
+  q16_t acc = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < BENCH_CALLS; i++) acc += (c.*step)(in_q[i & (BENCH_INPUTS - 1)]);
+  auto t1 = std::chrono::steady_clock::now();
+  sink = acc;
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / BENCH_CALLS;
+}
+
+static Report run_pid(const PidCase& k) {
+  pid_float::PIDController f(k.P, k.I, k.D, k.ramp, k.limit);
+  pid_fixed::PIDController q(k.P, k.I, k.D, k.ramp, k.limit);
+  f.setSampleTime(k.Ts);
+  q.setSampleTime(k.Ts);
+
+  std::vector<float> e = error_sequence(k.error_amp, 12345);
+  double max_err = 0, sum_sq = 0;
+  for (int i = 0; i < STEPS; i++) {
+    if (k.Ts == 0) host_time_us += next_dt_us(i);
+    double d = fabs((double)q(e[i]) - f(e[i]));
+    if (d > max_err) max_err = d;
+    sum_sq += d * d;
+  }
+
+  // the benchmark runs in the fixed sample time mode, as in the FOC and motion loops
+  pid_float::PIDController fb(k.P, k.I, k.D, k.ramp, k.limit);
+  pid_fixed::PIDController qb(k.P, k.I, k.D, k.ramp, k.limit);
+  fb.setSampleTime(k.Ts > 0 ? k.Ts : 5e-4f);
+  qb.setSampleTime(k.Ts > 0 ? k.Ts : 5e-4f);
+  std::vector<float> in(e.begin(), e.begin() + BENCH_INPUTS);
+  double ns_float = benchmark(fb, in), ns_fixed = benchmark(qb, in);
+  return {k.name, max_err, sqrt(sum_sq / STEPS), k.bound, ns_float, ns_fixed,
+          benchmark_q16(qb, &pid_fixed::PIDController::stepQ16, in)};
+}
+
+static Report run_lpf(const LpfCase& k) {
+  pid_float::LowPassFilter f(k.Tf);
+  pid_fixed::LowPassFilter q(k.Tf);
+  f.setSampleTime(k.Ts);
+  q.setSampleTime(k.Ts);
+
+  std::vector<float> x = error_sequence(k.amp, 777);
+  double max_err = 0, sum_sq = 0;
+  for (int i = 0; i < STEPS; i++) {
+    if (k.Ts == 0) host_time_us += next_dt_us(i);
+    double d = fabs((double)q(x[i]) - f(x[i]));
+    if (d > max_err) max_err = d;
+    sum_sq += d * d;
+  }
+
+  pid_float::LowPassFilter fb(k.Tf);
+  pid_fixed::LowPassFilter qb(k.Tf);
+  fb.setSampleTime(k.Ts > 0 ? k.Ts : 5e-4f);
+  qb.setSampleTime(k.Ts > 0 ? k.Ts : 5e-4f);
+  std::vector<float> in(x.begin(), x.begin() + BENCH_INPUTS);
+  double ns_float = benchmark(fb, in), ns_fixed = benchmark(qb, in);
+  return {k.name, max_err, sqrt(sum_sq / STEPS), k.bound, ns_float, ns_fixed,
+          benchmark_q16(qb, &pid_fixed::LowPassFilter::filterQ16, in)};
+}
+
+int main(int argc, char** argv) {
+  FILE* out = stdout;
+  if (argc > 1) {
+    out = fopen(argv[1], "w");
+    if (!out) {
+      fprintf(stderr, "can not open %s\n", argv[1]);
+      return 1;
+    }
+  }
+
+  // the bounds are a few Q16.16 LSB scaled by the gain that amplifies the quantisation
+  // of the input (P, I*Ts, D/Ts, or the Q15 filter coefficient times the amplitude)
+  const PidCase pid_cases[] = {
+    {"current_pi",          DEF_PID_CURR_P, DEF_PID_CURR_I, 0.0f,   1000.0f, 12.0f, 5e-4f, 2.0f,   2e-4},
+    {"velocity_pid",        0.2f,           20.0f,          0.001f, 1000.0f, 12.0f, 5e-3f, 20.0f,  5e-4},
+    {"angle_p",             20.0f,          0.0f,           0.0f,   0.0f,    20.0f, 5e-3f, 1.0f,   5e-4},
+    {"high_i_current_pi",   5.0f,           10000.0f,       0.0f,   0.0f,    12.0f, 5e-4f, 0.5f,   2e-3},
+    {"measured_current_pi", DEF_PID_CURR_P, DEF_PID_CURR_I, 0.0f,   1000.0f, 12.0f, 0.0f,  2.0f,   2e-4},
+  };
+  const LpfCase lpf_cases[] = {
+    {"current_lpf",  0.005f, 5e-4f, 2.0f,  5e-4},
+    {"velocity_lpf", 0.01f,  5e-3f, 50.0f, 2e-3},
+    {"measured_lpf", 0.005f, 0.0f,  2.0f,  5e-4},
+  };
+
+  std::vector<Report> reports;
+  for (const PidCase& k : pid_cases) reports.push_back(run_pid(k));
+  for (const LpfCase& k : lpf_cases) reports.push_back(run_lpf(k));
+
+  int failed = 0;
+  fprintf(out, "{\n  \"steps\": %d,\n  \"bench_calls\": %d,\n  \"cases\": [\n", STEPS, BENCH_CALLS);
+  for (size_t i = 0; i < reports.size(); i++) {
+    const Report& r = reports[i];
+    bool pass = r.max_err <= r.bound;
+    if (!pass) failed++;
+    fprintf(out, "    {\"name\": \"%s\", \"max_err\": %.3e, \"rms_err\": %.3e, \"bound\": %.1e, \"pass\": %s, "
+                 "\"ns_float\": %.3f, \"ns_fixed\": %.3f, \"ns_q16\": %.3f}%s\n",
+            r.name, r.max_err, r.rms_err, r.bound, pass ? "true" : "false",
+            r.ns_float, r.ns_fixed, r.ns_q16, i < reports.size() - 1 ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  if (out != stdout) fclose(out);
+  if (failed) fprintf(stderr, "%d case(s) out of bound\n", failed);
+  return failed ? 1 : 0;
+}
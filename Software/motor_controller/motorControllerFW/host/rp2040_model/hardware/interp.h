@@ -0,0 +1,63 @@
+// Host model of the RP2040 SIO interpolator, for compiling the RP2040 overrides on the host
+// (see host/foc_utils_bench.cpp). Only what the firmware uses is modelled: lanes 0 and 1 in
+// normal mode - shift, mask, cross input, base add - read through PEEK.
+// The registers are uintptr_t wide so that a table address added by a lane survives on a 64 bit host,
+// on the target they are the 32 bit SIO registers.
+// Included inside the namespace of the code under test, so no system headers here.
+
+#ifndef RP2040_MODEL_INTERP_H
+#define RP2040_MODEL_INTERP_H
+
+typedef struct {
+    unsigned shift;
+    unsigned mask_lsb;
+    unsigned mask_msb;
+    bool cross_input;
+} interp_config;
+
+struct interp_model_t;
+
+// PEEK of a lane: the result computed from the current accumulators, without a side effect
+struct interp_peek_model_t {
+    const interp_model_t* interp;
+    uintptr_t operator[](unsigned lane) const;
+};
+
+struct interp_model_t {
+    uintptr_t accum[2] = {0, 0};
+    uintptr_t base[3] = {0, 0, 0};
+    interp_config ctrl[2] = {};
+    interp_peek_model_t peek{this};
+
+    uintptr_t result(unsigned lane) const {
+        const interp_config& c = ctrl[lane];
+        uint32_t in = (uint32_t)accum[c.cross_input ? 1 - lane : lane];
+        uint32_t mask = (c.mask_msb >= 31 ? 0xffffffffu : ((1u << (c.mask_msb + 1)) - 1)) & ~((1u << c.mask_lsb) - 1);
+        return (uintptr_t)((in >> c.shift) & mask) + base[lane];
+    }
+};
+
+inline uintptr_t interp_peek_model_t::operator[](unsigned lane) const { return interp->result(lane); }
+
+typedef interp_model_t interp_hw_t;
+
+static interp_model_t interp1_model;
+#define interp1 (&interp1_model)
+
+static inline interp_config interp_default_config() {
+    interp_config c = {0, 0, 31, false};
+    return c;
+}
+
+static inline void interp_config_set_shift(interp_config* c, unsigned shift) { c->shift = shift; }
+
+static inline void interp_config_set_mask(interp_config* c, unsigned mask_lsb, unsigned mask_msb) {
+    c->mask_lsb = mask_lsb;
+    c->mask_msb = mask_msb;
+}
+
+static inline void interp_config_set_cross_input(interp_config* c, bool cross_input) { c->cross_input = cross_input; }
+
+static inline void interp_set_config(interp_hw_t* interp, unsigned lane, interp_config* config) { interp->ctrl[lane] = *config; }
+
+#endif
@@ -0,0 +1,10 @@
+// Host model of the RP2040 sync functions used by the overrides: one core, no interrupts
+
+#ifndef RP2040_MODEL_SYNC_H
+#define RP2040_MODEL_SYNC_H
+
+static inline uint32_t save_and_disable_interrupts() { return 0; }
+static inline void restore_interrupts(uint32_t) {}
+static inline unsigned get_core_num() { return 0; }
+
+#endif
@@ -0,0 +1,192 @@
+// Host fit and validation of the sensor nonlinearity calibration (common/sensor_calibration.cpp)
+//
+// Reads a sweep recorded by StepperMotor::calibrateSensor() with print_samples set: the lines
+// "CAL pass reference measured" of the serial log, everything else is skipped, so the raw log can be used.
+// The table is fitted on the whole sweep with the firmware code, and cross validated by fitting one
+// direction and testing on the other. The error statistics are taken about the mean, the constant
+// part (load lag, zero offset) is not corrected by the table.
+// The report is written as JSON, including the table.
+//
+// The synthetic mode generates a sweep of a 14 bit sensor with a known eccentricity, load lag and noise
+// instead, and additionally reports the error against the true angle.
+//
+// usage: sensor_calibration_fit sweep.log [report.json] [pole_pairs]
+//        sensor_calibration_fit synthetic [report.json] [pole_pairs]
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "common/sensor_calibration.h"
+
+struct Sample {
+  int pass;
+  uint32_t reference;
+  uint32_t measured;
+  uint32_t truth; // synthetic mode only
+};
+
+// error statistics about the mean [rad]
+struct ErrorStats {
+  double sum = 0;
+  double sum_sq = 0;
+  double min_err = 1e9;
+  double max_err = -1e9;
+  long n = 0;
+  void add(double e) {
+    sum += e;
+    sum_sq += e * e;
+    if (e < min_err) min_err = e;
+    if (e > max_err) max_err = e;
+    n++;
+  }
+  double rms() const { return n ? sqrt(fmax(sum_sq / n - (sum / n) * (sum / n), 0.0)) : 0; }
+  double peak() const { return n ? fmax(max_err - sum / n, sum / n - min_err) : 0; }
+};
+
+static const double RAD_TO_DEG = 180.0 / M_PI;
+
+static bool read_sweep(const char* path, std::vector<Sample>& sweep) {
+  FILE* in = fopen(path, "r");
+  if (!in) return false;
+  char line[256];
+  while (fgets(line, sizeof(line), in)) {
+    const char* cal = strstr(line, "CAL ");
+    if (!cal) continue;
+    Sample s = {0, 0, 0, 0};
+    unsigned long reference, measured;
+    if (sscanf(cal, "CAL %d %lu %lu", &s.pass, &reference, &measured) != 3) continue;
+    s.reference = (uint32_t)reference;
+    s.measured = (uint32_t)measured;
+    sweep.push_back(s);
+  }
+  fclose(in);
+  return true;
+}
+
+// open-loop sweep as StepperMotor::calibrateSensor() runs it, with a 14 bit sensor on an eccentric magnet
+static void synthetic_sweep(int pole_pairs, std::vector<Sample>& sweep) {
+  const int steps_per_pole = 32;
+  const int steps = pole_pairs * steps_per_pole;
+  const double offset = 0.3;                 // sensor zero [turns]
+  const double ecc1 = 0.8 / 360, ecc2 = 0.15 / 360, ecc3 = 0.03 / 360; // harmonics of the sensor error [turns]
+  const double lag = 0.05 / 360;             // load lag of the open-loop steps [turns]
+  const double noise = 0.02 / 360;           // sensor noise [turns]
+  std::mt19937 rng(1);
+  std::normal_distribution<double> gauss(0.0, noise);
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i <= steps; i++) {
+      int step = pass == 0 ? i : steps - i;
+      double shaft = (double)step / steps - (pass == 0 ? lag : -lag);
+      double a = 2 * M_PI * shaft;
+      double sensed = shaft + offset + ecc1 * sin(a + 0.4) + ecc2 * sin(2 * a + 1.1) + ecc3 * cos(3 * a) + gauss(rng);
+      sensed -= floor(sensed);
+      uint32_t count = (uint32_t)(sensed * 16384) & 0x3FFF;
+      double truth = shaft + offset;
+      truth -= floor(truth);
+      Sample s;
+      s.pass = pass;
+      s.reference = (uint32_t)(((uint64_t)step << 32) / steps);
+      s.measured = count << 18;
+      s.truth = (uint32_t)(uint64_t)(truth * 4294967296.0);
+      sweep.push_back(s);
+    }
+  }
+}
+
+// fit on the samples of one pass (-1 for all)
+static bool fit(const std::vector<Sample>& sweep, int pass, SensorCalibration& calibration) {
+  calibration.begin();
+  for (const Sample& s : sweep)
+    if (pass < 0 || s.pass == pass) calibration.addSample(s.reference, s.measured);
+  return calibration.fit();
+}
+
+// error of the samples of one pass (-1 for all) against a fit
+static void validate(const std::vector<Sample>& sweep, int pass, const SensorCalibration& calibration,
+                     ErrorStats& before, ErrorStats& after) {
+  for (const Sample& s : sweep) {
+    if (pass >= 0 && s.pass != pass) continue;
+    before.add(calibration.error(s.reference, s.measured, false));
+    after.add(calibration.error(s.reference, s.measured, true));
+  }
+}
+
+static void print_stats(FILE* out, const char* name, const ErrorStats& st, int pole_pairs, bool last) {
+  fprintf(out, "    \"%s\": {\"rms_deg\": %.5f, \"peak_deg\": %.5f, \"rms_electrical_deg\": %.4f, \"peak_electrical_deg\": %.4f, \"samples\": %ld}%s\n",
+          name, st.rms() * RAD_TO_DEG, st.peak() * RAD_TO_DEG, st.rms() * RAD_TO_DEG * pole_pairs, st.peak() * RAD_TO_DEG * pole_pairs,
+          st.n, last ? "" : ",");
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: sensor_calibration_fit sweep.log|synthetic [report.json] [pole_pairs]\n");
+    return 1;
+  }
+  bool synthetic = strcmp(argv[1], "synthetic") == 0;
+  int pole_pairs = argc > 3 ? atoi(argv[3]) : 50;
+
+  std::vector<Sample> sweep;
+  if (synthetic) synthetic_sweep(pole_pairs, sweep);
+  else if (!read_sweep(argv[1], sweep)) {
+    fprintf(stderr, "can not open %s\n", argv[1]);
+    return 1;
+  }
+
+  FILE* out = stdout;
+  if (argc > 2) {
+    out = fopen(argv[2], "w");
+    if (!out) {
+      fprintf(stderr, "can not open %s\n", argv[2]);
+      return 1;
+    }
+  }
+
+  // whole sweep: the table the firmware would store
+  static SensorCalibration calibration;
+  if (!fit(sweep, -1, calibration)) {
+    fprintf(stderr, "fit failed: %zu samples, the sweep has to cover the whole turn\n", sweep.size());
+    if (out != stdout) fclose(out);
+    return 1;
+  }
+  ErrorStats fit_before, fit_after;
+  validate(sweep, -1, calibration, fit_before, fit_after);
+
+  // cross validation: fitted on one direction, tested on the other
+  static SensorCalibration forward, backward;
+  ErrorStats cross_before, cross_after;
+  bool cross = fit(sweep, 0, forward) && fit(sweep, 1, backward);
+  if (cross) {
+    validate(sweep, 1, forward, cross_before, cross_after);
+    validate(sweep, 0, backward, cross_before, cross_after);
+  }
+
+  fprintf(out, "{\n  \"samples\": %zu,\n  \"pole_pairs\": %d,\n  \"table_size\": %d,\n  \"harmonics\": %d,\n",
+          sweep.size(), pole_pairs, SENSOR_CALIBRATION_SIZE, SENSOR_CALIBRATION_HARMONICS);
+  fprintf(out, "  \"max_correction_deg\": %.5f,\n  \"errors\": {\n", calibration.max_correction * RAD_TO_DEG);
+  print_stats(out, "fit_before", fit_before, pole_pairs, false);
+  print_stats(out, "fit_after", fit_after, pole_pairs, !cross && !synthetic);
+  if (cross) {
+    print_stats(out, "cross_before", cross_before, pole_pairs, false);
+    print_stats(out, "cross_after", cross_after, pole_pairs, !synthetic);
+  }
+  if (synthetic) {
+    // against the true shaft angle: what is left for the electrical angle
+    ErrorStats truth_before, truth_after;
+    for (const Sample& s : sweep) {
+      truth_before.add((int32_t)(s.measured - s.truth) * (2 * M_PI / 4294967296.0));
+      truth_after.add((int32_t)(calibration.correct(s.measured) - s.truth) * (2 * M_PI / 4294967296.0));
+    }
+    print_stats(out, "truth_before", truth_before, pole_pairs, false);
+    print_stats(out, "truth_after", truth_after, pole_pairs, true);
+  }
+  fprintf(out, "  },\n  \"table\": [");
+  for (int i = 0; i < SENSOR_CALIBRATION_SIZE; i++)
+    fprintf(out, "%s%d", i ? (i % 16 ? ", " : ",\n    ") : "\n    ", calibration.table[i]);
+  fprintf(out, "\n  ]\n}\n");
+  if (out != stdout) fclose(out);
+  return 0;
+}
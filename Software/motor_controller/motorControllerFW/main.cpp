@@ -6,9 +6,11 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
+#include "pico/flash.h"
 #include "pico/binary_info.h"
 #include "hardware/adc.h"
 #include "hardware/irq.h"
+#include "hardware/clocks.h"
 #include "RP2040.h"
 
 extern "C" {
@@ -16,10 +18,19 @@ extern "C" {
 }
 
 #include "sensors/MT6701_I2C.h"
+#include "sensors/MT6701_Fused.h"
 #include "drivers/StepperDriver4PWM.h"
 #include "StepperMotor.h"
+#include "common/load_torque_observer.h"
 #include "communication/Commander.h"
 #include "current_sense/InlineCurrentSense.h"
+#include "drivers/rp2040_mcu.h"
+#include "control/FOCScheduler.h"
+#include "communication/telemetry.h"
+#include "communication/DeferredLog.h"
+#include "common/probes.h"
+#include "common/cycle_counter.h"
+#include "common/fixed_point_bench.h"
 /*******************************************************************************
 * Pin Definitions
 */
@@ -52,33 +63,76 @@ StepperMotor motor = StepperMotor(50);
 // StepperDriver4PWM(ph1A, ph1B, ph2A, ph2B, (en1, en2 optional))
 StepperDriver4PWM driver = StepperDriver4PWM(6, 7, 8, 9, NOT_SET, NOT_SET);
 
+// Current sensing with the DRV8251A IPROPI outputs - magnitude only, the sign follows the current setpoint
+const float DRV8251A_MV_PER_AMP = 784.5f; // IPROPI mirror gain x IPROPI resistor
+InlineCurrentSense current_sense = InlineCurrentSense(DRV8251A_MV_PER_AMP, ADC_CURRENT_A_PIN, ADC_CURRENT_B_PIN);
+const float current_loop_bandwidth = 600.0f; // [rad/s], ~1/20 of the 2kHz FOC rate
+const float current_bandwidth_step = 0.3f; // d current step of the bandwidth measurement [A]
+
+// Bus voltage, converted with the phase currents and used for the duty cycle of the driver
+const float VBUS_DIVIDER_RATIO = 16.0f; // VBUS / ADC pin voltage
+const float vbus_undervoltage = 18.0f; // [V] CAN event below
+const float vbus_overvoltage = 30.0f; // [V] CAN event above
+const float vbus_hysteresis = 1.0f; // [V] back to ok this far inside the limits
+BusVoltageState vbus_state = BUS_VOLTAGE_OK;
+
 // CAN constants
 uint8_t pio_num = 0;
 uint8_t gpio_rx = 1, gpio_tx = 0;
 struct can2040 cbus;
 
-int can_downsample = 10; // downsample the can bus to 1s
+const uint32_t can_angle_period_us = 10000; // angle broadcast period
+const uint32_t status_period_us = 1000000; // status print period
+
+// telemetry from the core0 main loop (the only producer) to the CAN transmitter on core1
+TelemetryRing telemetry;
+
+// runs loopFOC from the PWM wrap interrupt and move as a lower rate group
+FOCScheduler scheduler = FOCScheduler(&motor);
+
+// serial command interface
+Commander command = Commander();
+void onProbes(char* cmd) { command.probes(cmd); }
 
 // Sensor constants
 #define I2C_PORT i2c1
 const uint8_t I2C_SDA_PIN = 2;
 const uint8_t I2C_SCL_PIN = 3;
 MT6701_I2C sensor = MT6701_I2C(sensor_default); // Create an instance of the MT6701_I2C class
-
-//
+// analog output converted with the phase currents at the PWM rate, offset and gain corrected by the I2C reads
+// opt-in: over one turn the 12 bit conversion is coarse at 50 pole pairs, the I2C angle commutates by default
+MT6701_Fused fused_sensor = MT6701_Fused(&sensor, ADC_MT6701_PIN, motor);
+const bool use_fused_sensor = false;
+Sensor* motor_sensor = use_fused_sensor ? (Sensor*)&fused_sensor : (Sensor*)&sensor; // sensor commutating the motor
+// magnet eccentricity correction of the I2C angle, fitted from an open-loop sweep and kept in flash
+// the sweep turns the shaft a full turn both ways, it only runs when requested here - mind the hard stops
+SensorCalibration sensor_calibration;
+const bool recalibrate_sensor = false; // run the sweep on this boot and store the table, e.g. after remounting the magnet
+
+// shaft velocity and load torque from an observer at the FOC rate instead of the angle difference + LPF_velocity
+// 150rad/s: <1ms lag at half the noise of the 5ms LPF (host/foc_utils_bench velocity)
+// the load torque needs the inertia (CAN 0x0E), without it the observer only tracks the angle
+LoadTorqueObserver velocity_estimator = LoadTorqueObserver(150);
+
+// angle and velocity of the linked motor
 float linked_angle;
+float linked_velocity;
 
-bool received_can = 0;
-bool recieved_target = 0;
+volatile bool received_can = 0;
+volatile bool recieved_target = 0;
+volatile bool params_dirty = 0; // set by the CAN callback when a motor parameter changed
+volatile uint8_t probe_request = PROBE_REQUEST_NONE; // probe stage requested over CAN, answered from the main loop
 
 // Global variables for storing received CAN data
 float R, L, kV, vel_Lim, V_lim, I_lim;
+float J = NOT_SET; // rotor and load inertia
 int sensor_direction;
 float _zero_electric_angle;
 float vel_kp, vel_ki, vel_kd;
 float pos_kp, pos_ki, pos_kd;
 uint8_t controller;
 float target;
+float ff_velocity, ff_acceleration, ff_torque; // feed forward setpoints
 float get_position, get_velocity;
 
 /*******************************************************************************
@@ -94,8 +148,8 @@ void process_can_data(uint32_t id, void *dest, size_t expected_size, const struc
     if (msg->dlc == expected_size) {
         memcpy(dest, msg->data, expected_size);
     } else {
-        printf("Invalid data length for CAN ID: 0x%03X (Motor %d). Expected: %zu, Received: %d\n",
-               id, motor, expected_size, msg->dlc);
+        DLOG("Invalid data length for CAN ID: 0x%03X (Motor %d). Expected: %u, Received: %d\n",
+               id, thisMotor, (unsigned)expected_size, msg->dlc);
     }
 }
 
@@ -130,8 +184,8 @@ static void can2040_cb(struct can2040 *cd, uint32_t notify, struct can2040_msg *
                     sensor_direction = msg->data[0]; // First byte is the boolean
                     memcpy(&_zero_electric_angle, &msg->data[1], sizeof(float)); // Remaining bytes are the float
                 } else {
-                    printf("Invalid data length for CAN ID: 0x%03X (Motor %d). Expected: %zu, Received: %d\n",
-                           msg->id, thisMotor, sizeof(float) + 1, msg->dlc);
+                    DLOG("Invalid data length for CAN ID: 0x%03X (Motor %d). Expected: %u, Received: %d\n",
+                           msg->id, thisMotor, (unsigned)(sizeof(float) + 1), msg->dlc);
                 }
                 break;
             case 0x07: // vel_kp
@@ -154,21 +208,40 @@ static void can2040_cb(struct can2040 *cd, uint32_t notify, struct can2040_msg *
                 break;
             case 0x0D: // controller
                 process_can_data(msg->id, &controller, sizeof(uint8_t), msg);
-                printf("Received controller: %d\n", controller);
+                DLOG("Received controller: %d\n", controller);
                 received_can = true;
                 break;
+            case 0x0E: // inertia
+                process_can_data(msg->id, &J, sizeof(float), msg);
+                break;
             case 0x14: // target
                 process_can_data(msg->id, &target, sizeof(float), msg);
                 recieved_target = true;
                 break;
+            case 0x15: // velocity feed forward
+                process_can_data(msg->id, &ff_velocity, sizeof(float), msg);
+                break;
+            case 0x16: // acceleration feed forward
+                process_can_data(msg->id, &ff_acceleration, sizeof(float), msg);
+                break;
+            case 0x17: // torque feed forward
+                process_can_data(msg->id, &ff_torque, sizeof(float), msg);
+                break;
+            case 0x19: // probe statistics request: stage index, PROBE_REQUEST_ALL or PROBE_REQUEST_RESET
+                if (msg->dlc >= 1) probe_request = msg->data[0];
+                break;
             default:
                 // printf("Unknown CAN ID: 0x%03X (Motor %d)\n", msg->id, thisMotor);
                 break;
         }
 
+        // motor parameters are applied to the motor in the main loop
+        if (relative_id <= 0x0C || relative_id == 0x0E) params_dirty = true;
+
         if(msg->id == ((((thisMotor + 2) % 4) << 8) + 0x018)) { 
             // Process the received angle
             memcpy(&linked_angle, msg->data, sizeof(float));
+            if (msg->dlc >= 2 * sizeof(float)) memcpy(&linked_velocity, &msg->data[sizeof(float)], sizeof(float));
             // printf("Received angle: %f\n", linked_angle);
         }
     }
@@ -180,7 +253,7 @@ static void can2040_cb(struct can2040 *cd, uint32_t notify, struct can2040_msg *
 
     if (notify & CAN2040_NOTIFY_ERROR) {
         // An error occurred
-        printf("CAN error occurred!\n");
+        DLOG("CAN error occurred!\n");
     }
 }
 
@@ -217,32 +290,103 @@ void adc_setup(void) {
     adc_gpio_init(ADC_VBUS_PIN); // VBUS input 3
 }
 
+// time of the sine/cosine kernels used by setPhaseVoltage, against the separate _sin + _cos
+// (~110us per call in the setPhaseVoltage comment) they replaced
+void printSincosTiming(void) {
+    const int calls = 256;
+    volatile float sink = 0.0f;
+    float s, c;
+    q15_t s_q, c_q;
+    float us_per_cycle = 1e6f / clock_get_hz(clk_sys);
+    _cycleCounterInit();
+
+    uint32_t start = _cycles();
+    for (int i = 0; i < calls; i++) sink = sink + _sin(i * 0.0245f) + _cos(i * 0.0245f);
+    uint32_t sin_cos = _cyclesSince(start) / calls;
+
+    start = _cycles();
+    for (int i = 0; i < calls; i++) { _sincos(i * 0.0245f, &s, &c); sink = sink + s + c; }
+    uint32_t sincos = _cyclesSince(start) / calls;
+
+    start = _cycles();
+    for (int i = 0; i < calls; i++) { _sincos_q15((uint32_t)i << 24, &s_q, &c_q); sink = sink + s_q + c_q; }
+    uint32_t sincos_q15 = _cyclesSince(start) / calls;
+
+    printf("sin/cos cycles per call: _sin+_cos %lu (%.2f us), _sincos %lu (%.2f us), _sincos_q15 %lu (%.2f us)\n",
+        (unsigned long)sin_cos, sin_cos * us_per_cycle, (unsigned long)sincos, sincos * us_per_cycle,
+        (unsigned long)sincos_q15, sincos_q15 * us_per_cycle);
+}
+
 void core1_main() {
+    // core0 pauses this core while it writes the flash (sensor calibration)
+    flash_safe_execute_core_init();
     canbus_setup();
     printf("Entered core0 (core=%d)\n", get_core_num());
     
-    // Send a CAN message
-    struct can2040_msg tx_msg = {
-        .id = (thisMotor << 8) + 0x018, // Set the ID for the message
-        .dlc = sizeof(float),
-    };
-
-    uint32_t raw_data; // Initialize raw_data
-    float angle; // Initialize angle
+    struct can2040_msg tx_msg = {};
+
+    // drain the telemetry ring in batches, core0 never waits on the bus
+    // a record stays in the batch until can2040 accepts it, when the ring overflows in the
+    // meantime the oldest records are dropped there instead
+    TelemetryRecord batch[TELEMETRY_TX_BATCH];
+    uint32_t batch_len = 0, batch_pos = 0;
     while (1) {
-        raw_data = multicore_fifo_pop_blocking(); // Receive raw 32-bit data
+        if (batch_pos == batch_len) {
+            batch_len = telemetry.pop(batch, TELEMETRY_TX_BATCH);
+            batch_pos = 0;
+            if (!batch_len) continue;
+        }
+        // transmit queue full, retry on the next pass
+        if (!can2040_check_transmit(&cbus)) continue;
 
-        memcpy(&angle, &raw_data, sizeof(float)); // Copy the raw data back into a float
-        memcpy(tx_msg.data, &angle, sizeof(float)); // Copy the angle to the CAN message data
+        tx_msg.id = (thisMotor << 8) + batch[batch_pos].type;
+        tx_msg.dlc = batch[batch_pos].dlc;
+        memcpy(tx_msg.data, batch[batch_pos].data, sizeof(tx_msg.data));
+        if (can2040_transmit(&cbus, &tx_msg) == 0) batch_pos++;
+    }
 
-        int result = can2040_transmit(&cbus, &tx_msg);
-        if (result == 0) {
-            // printf("Message queued for transmission.\n");
-        } else {
-            printf("Failed to queue message for transmission. Error: %d\n", result);
-        }
+}
+
+// Answer a probe request with one TELEMETRY_PROBE record per stage
+void send_probes(uint8_t request) {
+    if (request == PROBE_REQUEST_RESET) {
+        probesReset();
+        return;
+    }
+    for (int i = 0; i < PROBE_COUNT; i++) {
+        if (request != PROBE_REQUEST_ALL && request != i) continue;
+        ProbeStats stats;
+        probeRead((ProbeStage)i, &stats);
+        uint32_t mean = stats.count ? (uint32_t)(stats.sum / stats.count) : 0;
+        telemetry.push(telemetryProbe(i, PROBE_COUNT, stats.count ? stats.min : 0, mean, stats.max));
     }
+}
+
+// Tuning of the linked angle torque mode, reusing the velocity PID parameters
+float offset = 0.0f; // Offset for the target angle
+float deadband = offset; // Deadband for the target torque
+float gain = 5.0f; // Gain for the error term
+float velocity_noise = 0.1f; // Noise in the velocity measurement
+
+// Copy the parameters received over CAN into the motor
+// Only the limits and gains, the controller type and motor constants are applied at init
+void apply_params(void) {
+    motor.voltage_limit = V_lim; // Volts
+    motor.current_limit = I_lim; // Amps
+
+    motor.PID_velocity.P = vel_kp; // Set the velocity PID parameters
+    motor.PID_velocity.I = vel_ki;
+    motor.PID_velocity.D = vel_kd;
+
+    motor.P_angle.P = pos_kp; // Set the position PID parameters
+    motor.P_angle.I = pos_ki;
+    motor.P_angle.D = pos_kd;
+    motor.velocity_limit = vel_Lim; // Set the position limit
+    motor.inertia = J;
 
+    gain = vel_kp;
+    offset = vel_ki;
+    velocity_noise = vel_kd;
 }
 
 int main() {
@@ -255,13 +399,19 @@ int main() {
     // Wait for the CAN RX notify flag
     while (!( received_can)) {
         printf("Waiting for CAN RX notify...\n");
+        deferredLogDrain(4);
         tight_loop_contents(); // Wait in a tight loop
     }
     printf("Start... \n");
 
     sensor.init(I2C_PORT, I2C_SCL_PIN, I2C_SDA_PIN); // Initialize the MT6701_I2C instance   
+    // from now on the angle register is read by the I2C interrupt, loopFOC takes the newest sample
+    if (!sensor.startBackgroundRead()) printf("MT6701 background read not started, reading blocking\n");
+    // before the current sense starts the ADC engine, which then converts the analog output as well
+    if (use_fused_sensor && !fused_sensor.init()) printf("MT6701 analog output not converted, using the I2C angle\n");
     // link the motor to the sensor
-    motor.linkSensor(&sensor);
+    motor.linkSensor(motor_sensor);
+    motor.linkVelocityEstimator(&velocity_estimator);
 
     driver.voltage_power_supply = 24; // set the power supply voltage for the driver
     driver.voltage_limit = 24; // set the voltage limit for the driver
@@ -269,6 +419,15 @@ int main() {
     driver.init();
     motor.linkDriver(&driver);
 
+    // current sensing, the phase currents are read by the ADC engine in the background
+    current_sense.linkDriver(&driver);
+    current_sense.unipolar = true;
+    current_sense.skip_align = true; // the sign comes from the driver, nothing to align
+    current_sense.pinVbus = ADC_VBUS_PIN; // converted with the phase currents
+    current_sense.vbus_ratio = VBUS_DIVIDER_RATIO;
+    if (current_sense.init()) motor.linkCurrentSense(&current_sense);
+    else printf("Current sense init failed, torque control in voltage mode\n");
+
     motor.PID_velocity.P = 0.2;
     motor.PID_velocity.I = 20;
     motor.PID_velocity.D = 0.001;
@@ -296,6 +455,8 @@ int main() {
 
     motor.voltage_sensor_align = 14;
 
+    // current loop gains from the motor model, the defaults are kept without R and L
+    if (R > 0 && L > 0) motor.tuneCurrentController(current_loop_bandwidth);
 
     // Determine the controller type
     switch (controller) {
@@ -305,8 +466,8 @@ int main() {
             motor.voltage_limit = 0; // Volts
             motor.current_limit = 0; // Amps
             break;
-        case 1: // Torque control
-            motor.torque_controller = TorqueControlType::voltage;
+        case 1: // Torque control - target in Amps with current sensing, in Volts without
+            motor.torque_controller = motor.current_sense ? TorqueControlType::foc_current : TorqueControlType::voltage;
             motor.controller = MotionControlType::torque;
             break;
         case 2: // Position control
@@ -315,6 +476,14 @@ int main() {
         case 3: // Velocity control Open Loop
             motor.controller = MotionControlType::angle_openloop;
             break;
+        case 4: // Angle control closed loop - velocity, acceleration (J/Kt with the inertia) and torque feed forward from CAN
+            motor.torque_controller = motor.current_sense ? TorqueControlType::foc_current : TorqueControlType::voltage;
+            motor.controller = MotionControlType::angle;
+            break;
+        case 5: // Velocity control closed loop - acceleration and torque feed forward from CAN
+            motor.torque_controller = motor.current_sense ? TorqueControlType::foc_current : TorqueControlType::voltage;
+            motor.controller = MotionControlType::velocity;
+            break;
         default:
             printf("Unknown controller mode: %d\n", controller);
             break;
@@ -330,55 +499,65 @@ int main() {
     printf("Current Limit: %f Amps\n", I_lim);
     printf("Voltage Sensor Align: %f\n", motor.voltage_sensor_align);
 
+    printSincosTiming();
+    printFixedPointTiming();
+
     // initialize motor
     motor.init();
+    // sensor correction before the alignment, so the zero angle is found on the corrected angle
+    // fitted and applied on the I2C angle, the fused sensor applies it to its output as well
+    if (recalibrate_sensor) {
+        if (!motor.calibrateSensor(&sensor_calibration, 32, 2, true, &sensor)) printf("Sensor calibration failed, running uncorrected\n");
+        else if (!sensor_calibration.save()) printf("Sensor calibration not stored\n");
+    }
+    else if (sensor_calibration.load()) {
+        sensor.calibration = &sensor_calibration;
+        printf("Sensor calibration loaded, max correction %f deg\n", sensor_calibration.max_correction * 180.0f / _PI);
+    }
+    else printf("No sensor calibration stored, running uncorrected\n");
     // align sensor and start FOC
     motor.initFOC();
 
-    // motor.motion_downsample = 1; // downsample the motion control loop to 15ms
-    
-    int can_downsample_cnt = 0;
-    float angle;
-    uint32_t raw_data;
-
-    float offset = 0.0f; // Offset for the target angle
-    float deadband = offset; // Deadband for the target torque
-    float gain = 5.0f; // Gain for the error term
-    float velocity_noise = 0.1f; // Noise in the velocity measurement
+    // motion downsampling is done by the scheduler rate groups
+    motor.motion_downsample = 0;
+
     float error, targetTorque;
 
     sleep_ms(3000);
 
-    while (1) {
-        // main FOC algorithm function
-        // sensor.update(); // update the sensor
-        motor.loopFOC();
-
-        motor.voltage_limit = V_lim; // Volts
-        motor.current_limit = I_lim; // Amps
-
-        // Print the updated voltage and current limits to serial
-        // printf("Updated Voltage Limit: %f V\n", motor.voltage_limit);
-        // printf("Updated Current Limit: %f Amps\n", motor.current_limit);
-        motor.PID_velocity.P = vel_kp; // Set the velocity PID parameters
-        motor.PID_velocity.I = vel_ki;
-        motor.PID_velocity.D = vel_kd;
-
-        motor.P_angle.P = pos_kp; // Set the position PID parameters
-        motor.P_angle.I = pos_ki;
-        motor.P_angle.D = pos_kd;
-        motor.velocity_limit = vel_Lim; // Set the position limit
-
-        gain = vel_kp;
-        offset = vel_ki;
-        velocity_noise = vel_kd;
-
-
-        // Print all values to serial
-        // printf("Velocity PID: P=%f, I=%f, D=%f\n", vel_kp, vel_ki, vel_kd);
-        // printf("Position PID: P=%f, I=%f, D=%f\n", pos_kp, pos_ki, pos_kd);
-        // printf("Velocity Limit: %f\n", vel_Lim);
+    // start the FOC and motion rate groups, synchronous to the PWM of the driver
+    RP2040DriverParams* driver_params = (RP2040DriverParams*)driver.params;
+    if (!scheduler.init(driver_params->slice[0], driver_params->pwm_frequency)) {
+        // no control loop will run - leave the bridge off and keep reporting instead of returning
+        motor.disable();
+        driver.disable();
+        while (1) {
+            printf("No free interrupt for the motion loop, motor disabled!\n");
+            deferredLogDrain(4);
+            sleep_ms(1000);
+        }
+    }
+    apply_params();
+    // the probes are recorded in the scheduler interrupts, on this core
+    probesInit();
+    command.add('P', onProbes, "probes");
+    scheduler.start();
+
+    if (motor.torque_controller == TorqueControlType::foc_current) {
+        float bandwidth = motor.measureCurrentBandwidth(current_bandwidth_step);
+        if (_isset(bandwidth)) printf("Current loop bandwidth: %f rad/s (%f Hz)\n", bandwidth, bandwidth / _2PI);
+        else printf("Current loop bandwidth: step not reached\n");
+        if (_isset(motor.current_bandwidth)) printf("Current loop tuned for: %f rad/s\n", motor.current_bandwidth);
+    }
 
+    // housekeeping - the control loops run in the scheduler interrupts
+    uint32_t can_tx_ts = time_us_32();
+    uint32_t status_ts = can_tx_ts;
+    while (1) {
+        if (params_dirty) {
+            params_dirty = false;
+            apply_params();
+        }
 
         // // Determine offset based on the direction of the difference
         error = linked_angle - motor.shaft_angle;
@@ -389,24 +568,63 @@ int main() {
             targetTorque = 0.0f; // Set to zero if within the deadband
         }
 
-        printf("target: %f| otherAngle: %f| Myangle: %f \n", target, linked_angle, sensor.getAngle());
-
         if(controller == 1) {
             target = targetTorque; // Set the target torque
         }
+        // picked up by the next motion step
+        motor.target = target;
+        motor.feed_forward_velocity = ff_velocity;
+        motor.feed_forward_acceleration = ff_acceleration;
+        motor.feed_forward_torque = ff_torque;
+
+        uint32_t now = time_us_32();
+        if (now - can_tx_ts >= can_angle_period_us) {
+            // Send the sensor angle and velocity to core 1 - never blocks, drops the oldest record if core1 fell behind
+            // the velocity lets the linked motor use it as a feed forward
+            telemetry.push(telemetryFloat2(TELEMETRY_ANGLE, motor_sensor->getAngle(), motor.shaft_velocity * motor.sensor_direction));
+            if (_isset(motor.inertia)) telemetry.push(telemetryFloat(TELEMETRY_LOAD_TORQUE, motor.estimated_load_torque));
+            can_tx_ts = now;
+        }
+
+        // bus voltage events, with hysteresis
+        float vbus = current_sense.bus_voltage;
+        if (_isset(vbus)) {
+            BusVoltageState state = vbus_state;
+            if (vbus < vbus_undervoltage) state = BUS_VOLTAGE_UNDER;
+            else if (vbus > vbus_overvoltage) state = BUS_VOLTAGE_OVER;
+            else if (vbus > vbus_undervoltage + vbus_hysteresis && vbus < vbus_overvoltage - vbus_hysteresis) state = BUS_VOLTAGE_OK;
+            if (state != vbus_state) {
+                vbus_state = state;
+                telemetry.push(telemetryBusVoltage(state, vbus));
+                DLOG("Bus voltage %s: %f V\n", state == BUS_VOLTAGE_OK ? "ok" : (state == BUS_VOLTAGE_UNDER ? "under" : "over"), vbus);
+            }
+        }
 
-        motor.move(target); // target torque
-        
-        if(can_downsample_cnt == can_downsample) {
-            // Send the sensor angle to core 1
-            // Convert the angle to a 32-bit integer representation
-            angle = sensor.getAngle(); // Get the angle from the motor
-            memcpy(&raw_data, &angle, sizeof(float)); // Convert float to uint32_t
-            multicore_fifo_push_blocking(raw_data); // Send the data to core 1
-        
-            can_downsample_cnt = 0; // Reset downsample counter
+        if (probe_request != PROBE_REQUEST_NONE) {
+            send_probes(probe_request);
+            probe_request = PROBE_REQUEST_NONE;
         }
-        can_downsample_cnt++;
+
+        if (now - status_ts >= status_period_us) {
+            DLOG("target: %f| otherAngle: %f (%f rad/s)| Myangle: %f \n", target, linked_angle, linked_velocity, motor_sensor->getAngle());
+            DLOG("VBUS: %f V, supply used for the duty cycle: %f V\n", current_sense.bus_voltage, driver.voltage_power_supply);
+            if (current_sense.sign_samples)
+                DLOG("Current sign: %f of the reads differ from the voltage polarity\n",
+                     (float)current_sense.sign_disagreements / current_sense.sign_samples);
+            DLOG("Angle latency: %f us\n", motor.angle_latency * 1e6f);
+            DLOG("FOC: %" PRIu32 " steps, %" PRIu32 "/%" PRIu32 " cycles (max/budget), %" PRIu32 " overruns\n",
+                 scheduler.foc.count, scheduler.foc.cycles_max, scheduler.foc.budget, scheduler.foc.overruns);
+            DLOG("Motion: %" PRIu32 " steps, %" PRIu32 "/%" PRIu32 " cycles (max/budget), %" PRIu32 " overruns\n",
+                 scheduler.motion.count, scheduler.motion.cycles_max, scheduler.motion.budget, scheduler.motion.overruns);
+            DLOG("Telemetry: %" PRIu32 " pushed, %" PRIu32 " read by core1, %" PRIu32 " dropped | log dropped: %" PRIu32 "\n",
+                 telemetry.pushed(), telemetry.consumed(), telemetry.overflows(), deferredLogDropped());
+            status_ts = now;
+        }
+
+        // formatting and output of the deferred log, a few records per pass
+        deferredLogDrain(4);
+        // serial commands
+        command.run();
     }
 
    return 0;
@@ -0,0 +1,92 @@
+#include "MT6701_ABZ.h"
+#include "hardware/irq.h"
+#include "quadrature_encoder.pio.h"
+
+MT6701_ABZ* MT6701_ABZ::index_sensor = nullptr;
+
+MT6701_ABZ::MT6701_ABZ(uint8_t _pin_a, int _pin_z, uint16_t _ppr, MT6701_I2C* _absolute){
+    pin_a = _pin_a;
+    pin_z = _pin_z;
+    cpr = 4 * (int32_t)_ppr;
+    absolute = _absolute;
+}
+
+
+int MT6701_ABZ::init(PIO _pio) {
+    pio = _pio;
+    if (!pio_can_add_program_at_offset(pio, &quadrature_encoder_program, 0)) return 0;
+    sm = pio_claim_unused_sm(pio, false);
+    if (sm < 0) return 0;
+    pio_add_program_at_offset(pio, &quadrature_encoder_program, 0);
+    quadrature_encoder_program_init(pio, sm, pin_a);
+
+    // seed: the absolute angle in counts, rounded
+    int64_t turns = absolute->getSensorAngleTurns();
+    if (turns < 0) {
+        // I2C read failed - release the state machine and the program for a later retry
+        pio_sm_set_enabled(pio, sm, false);
+        pio_sm_unclaim(pio, sm);
+        pio_remove_program(pio, &quadrature_encoder_program, 0);
+        sm = -1;
+        return 0;
+    }
+    int32_t seed = (int32_t)((((uint64_t)turns * cpr) + ((uint64_t)1 << 31)) >> 32) % cpr;
+    count_offset = seed - count_direction * quadrature_encoder_get_count(pio, sm);
+
+    if (_isset(pin_z)) {
+        index_sensor = this;
+        gpio_init(pin_z);
+        gpio_set_dir(pin_z, GPIO_IN);
+        gpio_add_raw_irq_handler(pin_z, indexHandler);
+        gpio_set_irq_enabled(pin_z, GPIO_IRQ_EDGE_RISE, true);
+        irq_set_enabled(IO_IRQ_BANK0, true);
+    }
+
+    this->Sensor::init();
+    return 1;
+}
+
+
+int32_t MT6701_ABZ::getPosition() {
+    return count_offset + count_direction * quadrature_encoder_get_count(pio, sm);
+}
+
+
+void MT6701_ABZ::handleIndex() {
+    // the index marks the absolute zero: the position has to be a multiple of cpr
+    int32_t position = getPosition();
+    int32_t error = position % cpr;
+    if (error >= cpr / 2) error -= cpr;
+    else if (error < -cpr / 2) error += cpr;
+    z_pulses++;
+    z_last_error = error;
+    if (error > z_tolerance || error < -z_tolerance) {
+        count_offset -= error;
+        z_corrections++;
+    }
+}
+
+void MT6701_ABZ::indexHandler() {
+    if (!index_sensor) return;
+    uint pin = index_sensor->pin_z;
+    if (gpio_get_irq_event_mask(pin) & GPIO_IRQ_EDGE_RISE) {
+        gpio_acknowledge_irq(pin, GPIO_IRQ_EDGE_RISE);
+        index_sensor->handleIndex();
+    }
+}
+
+
+//  Shaft angle calculation
+//  angle is in radians [rad]
+float MT6701_ABZ::getSensorAngle(){
+    int32_t position = getPosition() % cpr;
+    if (position < 0) position += cpr;
+    return ( position / (float)cpr ) * _2PI;
+}
+
+//  Shaft angle as a binary angle, counts scaled into the 32 bit turn
+int64_t MT6701_ABZ::getSensorAngleTurns(){
+    int32_t position = getPosition() % cpr;
+    if (position < 0) position += cpr;
+    return (int64_t)(((uint64_t)position << 32) / (uint32_t)cpr);
+}
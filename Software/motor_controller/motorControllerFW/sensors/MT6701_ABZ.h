@@ -0,0 +1,69 @@
+#ifndef MT6701_ABZ_LIB_H
+#define MT6701_ABZ_LIB_H
+
+#include "common/base_classes/Sensor.h"
+#include "common/foc_utils.h"
+#include "hardware/pio.h"
+#include "pico/stdlib.h"
+#include "MT6701_I2C.h"
+
+/**
+ * MT6701 incremental ABZ output counted by a PIO state machine
+ *
+ * The absolute angle is read once over I2C in init() and seeds the count, from then on the position
+ * comes from the quadrature counter, which costs a few FIFO reads instead of an I2C transaction.
+ * Every Z pulse (the zero of the MT6701) snaps the count back onto the absolute angle, so missed
+ * or extra counts from noise do not accumulate.
+ * A and B have to be on consecutive pins (B = A + 1). The program takes 26 of the 32 instructions
+ * and has to be loaded at address 0, so it does not fit next to MT6701_SSI on the same PIO.
+ */
+class MT6701_ABZ: public Sensor{
+ public:
+    /**
+     * MT6701_ABZ class constructor
+     * @param pin_a  A pin, B is pin_a + 1
+     * @param pin_z  Z (index) pin, NOT_SET to run without the index resync
+     * @param ppr  pulses per revolution configured in the MT6701 (counts per revolution = 4*ppr)
+     * @param absolute  initialised I2C sensor the count is seeded from
+     */
+    MT6701_ABZ(uint8_t pin_a, int pin_z, uint16_t ppr, MT6701_I2C* absolute);
+
+    /**
+     * start the PIO counter, seed it with the absolute angle and initialise the Sensor base class
+     * @param pio  PIO block to use
+     * @returns 1 on success, 0 if the program does not fit, no state machine is free or the I2C read failed
+     */
+    int init(PIO pio = pio1);
+
+    // implementation of abstract functions of the Sensor class
+    /** get current angle (rad) */
+    float getSensorAngle() override;
+    /** get current angle as a binary angle (2^32 per turn) */
+    int64_t getSensorAngleTurns() override;
+
+    /** position in counts since init, 0 = absolute zero of the sensor */
+    int32_t getPosition();
+
+    int8_t count_direction = 1; //!< -1 if the counter counts against the absolute angle (A/B swapped)
+    uint8_t z_tolerance = 1; //!< index errors up to this many counts are left alone (edge position depends on direction)
+    volatile uint32_t z_pulses = 0; //!< index pulses seen
+    volatile uint32_t z_corrections = 0; //!< index pulses that corrected the count
+    volatile int32_t z_last_error = 0; //!< count error found at the last index pulse
+
+  private:
+    /** Z rising edge: snap the position onto the index */
+    void handleIndex();
+    static void indexHandler();
+    static MT6701_ABZ* index_sensor; //!< sensor serviced by the GPIO interrupt
+
+    uint8_t pin_a;
+    int pin_z;
+    int32_t cpr; //!< counts per revolution
+    MT6701_I2C* absolute;
+    PIO pio = nullptr;
+    int sm = -1;
+    volatile int32_t count_offset = 0; //!< position - count
+};
+
+
+#endif
@@ -0,0 +1,96 @@
+#include "MT6701_Fused.h"
+
+MT6701_Fused::MT6701_Fused(MT6701_I2C* _digital, int _analog_pin, const FOCMotor& _motor)
+    : digital(_digital), motor(_motor) {
+    analog_pin = _analog_pin;
+}
+
+
+int MT6701_Fused::init(RP2040ADCEngine* _adc) {
+    bool convertible = analog_pin >= 26 && analog_pin <= 29 && !(_adc->initialized && !_adc->channelsEnabled[analog_pin-26]);
+    if (convertible) {
+        adc = _adc;
+        adc->addPin(analog_pin);
+    }
+    // the engine is not running yet, the base class starts from the digital angle
+    this->Sensor::init();
+    return convertible ? 1 : 0;
+}
+
+
+void MT6701_Fused::correct(float analog, uint32_t digital_turns, int32_t dt_us) {
+    // digital angle at the time of the ADC frame, with the velocity in the sensor direction
+    float velocity = motor.velocity_estimator ? motor.velocity_estimator->velocity : motor.sensor_direction * motor.shaft_velocity;
+    float expected = digital_turns / 4294967296.0f + velocity * dt_us * (1e-6f / _2PI);
+    float error = expected - (gain * analog + offset);
+    error -= floorf(error + 0.5f); // shortest way, -0.5 to 0.5 turns
+    analog_error = error;
+
+    // thresholds in turns from the electrical angles
+    float to_turns = 1.0f / (_2PI * (motor.pole_pairs > 0 ? motor.pole_pairs : 1));
+    float abs_error = fabsf(error);
+    if (abs_error > resync_error * to_turns) {
+        offset += error;
+        agreeing = 0;
+        resyncs++;
+    }
+    else {
+        offset += offset_rate * error;
+        // the centred regressor keeps the gain correction from moving the offset
+        gain += gain_rate * error * (analog - 0.5f);
+        if (abs_error > agree_error * to_turns) agreeing = 0;
+        else if (agreeing < lock_count) agreeing++;
+    }
+    offset -= floorf(offset + 0.5f);
+}
+
+
+uint32_t MT6701_Fused::getSensorAngleAge(){
+    return time_us_32() - sample_time;
+}
+
+
+int64_t MT6701_Fused::output(uint32_t turns){
+    if (digital->calibration) turns = digital->calibration->correct(turns);
+    return (int64_t)turns;
+}
+
+
+//  Shaft angle calculation
+//  angle is in radians [rad]
+float MT6701_Fused::getSensorAngle(){
+    int64_t turns = getSensorAngleTurns();
+    if (turns < 0) return -1.0f;
+    return ( (uint32_t)turns / 4294967296.0f ) * _2PI;
+}
+
+//  Shaft angle as a binary angle, the analog angle corrected by the digital samples
+int64_t MT6701_Fused::getSensorAngleTurns(){
+    int64_t digital_turns = digital->getSensorAngleTurns();
+    if (digital_turns < 0) return -1;
+    MT6701_I2CSample_s sample = digital->getSample();
+    sample_time = sample.timestamp;
+
+    // no frames before the current sense started the engine, its DMA channels are not claimed yet
+    if (!adc || !adc->initialized) return output((uint32_t)digital_turns);
+    ADCFrame frame = adc->getLastFrame();
+    if ((uint32_t)(time_us_32() - frame.timestamp) > SIMPLEFOC_MT6701_ANALOG_STALE_US) {
+        agreeing = 0;
+        return output((uint32_t)digital_turns);
+    }
+    float fraction = frame.results.raw[analog_pin-26] / (float)(SIMPLEFOC_RP2040_ADC_RESOLUTION * adc->oversampling);
+    float analog = (fraction - analog_min) / (analog_max - analog_min);
+    bool near_wrap = analog < wrap_margin || analog > 1.0f - wrap_margin;
+
+    if (sample.timestamp != digital_timestamp) {
+        digital_timestamp = sample.timestamp;
+        if (!near_wrap) correct(analog, (uint32_t)digital_turns, (int32_t)(frame.timestamp - sample.timestamp));
+    }
+    if (near_wrap || agreeing < lock_count) return output((uint32_t)digital_turns);
+
+    // stamped when the frame is in, the middle of its conversions ((SIMPLEFOC_RP2040_ADC_TRIGGER_CLKDIV+1)/48MHz each with the PWM trigger)
+    sample_time = frame.timestamp - (uint32_t)(adc->frameLength * (SIMPLEFOC_RP2040_ADC_TRIGGER_CLKDIV + 1) / 96);
+    float turns = gain * analog + offset;
+    turns -= floorf(turns);
+    return output((uint32_t)(int64_t)(turns * 4294967296.0f));
+}
@@ -0,0 +1,94 @@
+#ifndef MT6701_FUSED_LIB_H
+#define MT6701_FUSED_LIB_H
+
+#include "common/base_classes/Sensor.h"
+#include "common/foc_utils.h"
+#include "pico/stdlib.h"
+#include "MT6701_I2C.h"
+#include "common/base_classes/FOCMotor.h"
+#include "current_sense/rp2040_mcu.h"
+
+// an ADC frame older than this counts as missing (engine not started yet), the digital angle is used
+#ifndef SIMPLEFOC_MT6701_ANALOG_STALE_US
+#define SIMPLEFOC_MT6701_ANALOG_STALE_US 500
+#endif
+
+
+/**
+ * MT6701 analog output fused with the digital angle
+ *
+ * The analog output (a sawtooth over one turn) is converted by the ADC engine with the phase currents,
+ * once per PWM period, so a fresh angle is available at every FOC step without any bus traffic.
+ * The background I2C reads are slower but exact: every new digital sample is compared with the analog
+ * angle and corrects its offset and gain, which drift with temperature and supply.
+ * The digital sample is moved to the time of the ADC frame with the velocity of the motor before the comparison.
+ * The thresholds are electrical angles: the 12 bit conversion over one turn is coarse on a motor with many
+ * pole pairs, so the analog angle is only used when it stays within agree_error of the digital one.
+ *
+ * Near the wrap of the sawtooth the analog value is unreliable (the output slews through the whole range),
+ * there the digital angle is returned and nothing is learnt. The digital angle is also returned until
+ * the analog angle has agreed with it for lock_count samples in a row, so a missing or misconfigured
+ * analog output (the MT6701 OUT pin mode is set in its EEPROM) just falls back to the digital angle.
+ * A calibration linked to the digital sensor is applied to the output, whichever source it comes from:
+ * both follow the raw digital angle the table was fitted on. The calibration of this sensor is not used.
+ *
+ * The digital sensor has to be initialised and reading in the background (startBackgroundRead()).
+ */
+class MT6701_Fused: public Sensor{
+ public:
+    /**
+     * MT6701_Fused class constructor
+     * @param digital  I2C sensor providing the absolute angle
+     * @param analog_pin  ADC pin (26-29) the analog output is connected to
+     * @param motor  motor the sensor is linked to, provides the velocity and the pole pairs
+     */
+    MT6701_Fused(MT6701_I2C* digital, int analog_pin, const FOCMotor& motor);
+
+    /**
+     * add the analog pin to the ADC engine and initialise the Sensor base class
+     * Call it before the current sense is initialised, that is when the engine configures its channels.
+     * @param adc  ADC engine converting the analog output
+     * @returns 1 on success, 0 if the pin is no ADC pin or the engine was already started without it,
+     *          the sensor then returns the digital angle only
+     */
+    int init(RP2040ADCEngine* adc = &engine);
+
+    // implementation of abstract functions of the Sensor class
+    /** get current angle (rad) */
+    float getSensorAngle() override;
+    /** get current angle as a binary angle (2^32 per turn) */
+    int64_t getSensorAngleTurns() override;
+    /** time since the sample of the last angle: the ADC frame or the digital sample */
+    uint32_t getSensorAngleAge() override;
+
+    float analog_min = 0.0f; //!< output at the zero angle as a fraction of VDDA, matching the MT6701 analog range setting
+    float analog_max = 1.0f; //!< output at one full turn as a fraction of VDDA
+    float wrap_margin = 0.02f; //!< fraction of the turn on each side of the sawtooth wrap where the digital angle is used
+    float offset_rate = 0.05f; //!< offset correction per digital sample, fraction of the error
+    float gain_rate = 0.02f; //!< gain correction per digital sample
+    float agree_error = 0.17f; //!< electrical error [rad] below which a sample counts as agreeing (~10 deg)
+    float resync_error = 0.52f; //!< electrical error [rad] above which the offset is reset to the digital angle instead of corrected (~30 deg)
+    uint16_t lock_count = 16; //!< agreeing samples in a row before the analog angle is used
+
+    float gain = 1.0f; //!< learnt gain of the analog angle
+    float offset = 0.0f; //!< learnt offset of the analog angle [turns]
+    float analog_error = 0.0f; //!< error [turns] of the analog angle at the last digital sample
+    uint32_t resyncs = 0; //!< offset resets, steadily counting means the analog output is not usable
+
+  private:
+    /** compare a digital sample with the analog angle and correct offset and gain */
+    void correct(float analog, uint32_t digital_turns, int32_t dt_us);
+    /** raw angle to output, with the calibration of the digital sensor */
+    int64_t output(uint32_t turns);
+
+    MT6701_I2C* digital;
+    const FOCMotor& motor;
+    RP2040ADCEngine* adc = nullptr;
+    int analog_pin;
+    uint32_t digital_timestamp = 0; //!< timestamp of the last digital sample used for the correction
+    uint16_t agreeing = 0; //!< agreeing samples in a row
+    uint32_t sample_time = 0; //!< sample time of the angle last returned [us]
+};
+
+
+#endif
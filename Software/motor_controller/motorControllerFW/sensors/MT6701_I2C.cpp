@@ -1,4 +1,7 @@
 #include "MT6701_I2C.h"
+#include "hardware/irq.h"
+
+MT6701_I2C* MT6701_I2C::background_sensor[2] = {nullptr, nullptr};
 
 
 /** Typical configuration for the 12bit MT6701 magnetic sensor over I2C interface */
@@ -22,6 +25,7 @@ MT6701_I2C::MT6701_I2C(uint8_t _chip_address, int _bit_resolution, uint8_t _angl
     angle_register_msb = _angle_register_msb;
     // register maximum value (counts per revolution)
     cpr = _powtwo(_bit_resolution);
+    turns_shift = 32 - _bit_resolution;
 
     // depending on the sensor architecture there are different combinations of
     // LSB and MSB register used bits
@@ -42,6 +46,7 @@ MT6701_I2C::MT6701_I2C(MT6701_I2CConfig_s config){
     angle_register_msb = config.angle_register;
     // register maximum value (counts per revolution)
     cpr = _powtwo(config.bit_resolution);
+    turns_shift = 32 - config.bit_resolution;
 
     int bits_used_msb = config.data_start_bit - 7;
     lsb_used = config.bit_resolution - bits_used_msb;
@@ -74,11 +79,138 @@ float MT6701_I2C::getSensorAngle(){
     return  ( getRawCount() / (float)cpr) * _2PI ;
 }
 
+//  Shaft angle as a binary angle, the raw count is left aligned into the 32 bit turn
+int64_t MT6701_I2C::getSensorAngleTurns(){
+    int raw = getRawCount();
+    if (raw < 0) return -1;
+    return (int64_t)((uint32_t)raw << turns_shift);
+}
+
 
 
 // function reading the raw counter of the magnetic sensor
 int MT6701_I2C::getRawCount(){
-	return (int)MT6701_I2C::read(angle_register_msb);
+    if (background) {
+        // newest background sample, no bus access
+        MT6701_I2CSample_s sample = getSample();
+        if ((uint32_t)(time_us_32() - sample.timestamp) > SIMPLEFOC_MT6701_STALE_US) {
+            currWireError = 1;
+            return -1;
+        }
+        currWireError = 0;
+        sample_time = sample.timestamp;
+        return sample.raw;
+    }
+    uint32_t start = time_us_32();
+    int raw = MT6701_I2C::read(angle_register_msb);
+    sample_time = start + (time_us_32() - start) / 2;
+	return raw;
+}
+
+uint32_t MT6701_I2C::getSensorAngleAge(){
+    return time_us_32() - sample_time;
+}
+
+// Background reads
+/*
+* The angle register is read with the I2C block's command FIFO: the register address, then two
+* read commands, the first with a restart and the last with a stop. The RX_FULL interrupt fires
+* when both bytes are in, the handler publishes the sample and queues the next read right away.
+* At 400kHz one read takes ~110us, so a new sample is there about every 110us.
+*/
+int MT6701_I2C::startBackgroundRead() {
+    uint port = i2c_hw_index(I2C_PORT);
+    if (background_sensor[port] && background_sensor[port] != this) return 0;
+    background_sensor[port] = this;
+
+    // the first sample with a blocking read, published before the interrupt runs
+    int raw = read(angle_register_msb);
+    samples[0].raw = raw < 0 ? 0 : raw;
+    samples[0].timestamp = raw < 0 ? time_us_32() - SIMPLEFOC_MT6701_STALE_US - 1 : time_us_32();
+    sample_index = 0;
+    background = true;
+
+    i2c_hw_t* hw = i2c_get_hw(I2C_PORT);
+    // the target address is fixed from now on
+    hw->enable = 0;
+    hw->tar = chip_address;
+    hw->enable = 1;
+    // RX_FULL once both bytes are in the FIFO (more than rx_tl entries)
+    hw->rx_tl = 1;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    uint irq = I2C0_IRQ + port;
+    irq_set_exclusive_handler(irq, port ? i2c1Handler : i2c0Handler);
+    irq_set_priority(irq, SIMPLEFOC_MT6701_IRQ_PRIORITY);
+    irq_set_enabled(irq, true);
+    queueRead();
+    return 1;
+}
+
+void MT6701_I2C::stopBackgroundRead() {
+    if (!background) return;
+    uint port = i2c_hw_index(I2C_PORT);
+    i2c_hw_t* hw = i2c_get_hw(I2C_PORT);
+    irq_set_enabled(I2C0_IRQ + port, false);
+    hw->intr_mask = 0;
+    // let the read in flight finish, then empty the FIFO for the blocking reads
+    uint32_t start = time_us_32();
+    while (hw->rxflr < 2 && !(hw->raw_intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) && time_us_32() - start < SIMPLEFOC_MT6701_STALE_US)
+        tight_loop_contents();
+    while (hw->rxflr) (void)hw->data_cmd;
+    (void)hw->clr_tx_abrt;
+    background = false;
+    background_sensor[port] = nullptr;
+}
+
+MT6701_I2CSample_s MT6701_I2C::getSample() {
+    // the interrupt writes the other slot and flips the index, it can not preempt the FOC step
+    uint8_t index = sample_index;
+    MT6701_I2CSample_s sample;
+    sample.raw = samples[index].raw;
+    sample.timestamp = samples[index].timestamp;
+    return sample;
+}
+
+void MT6701_I2C::queueRead() {
+    i2c_hw_t* hw = i2c_get_hw(I2C_PORT);
+    read_start = time_us_32();
+    hw->data_cmd = angle_register_msb;
+    hw->data_cmd = I2C_IC_DATA_CMD_CMD_BITS | I2C_IC_DATA_CMD_RESTART_BITS;
+    hw->data_cmd = I2C_IC_DATA_CMD_CMD_BITS | I2C_IC_DATA_CMD_STOP_BITS;
+}
+
+void MT6701_I2C::handleInterrupt() {
+    i2c_hw_t* hw = i2c_get_hw(I2C_PORT);
+    uint32_t status = hw->intr_stat;
+    if (status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // NACK or lost arbitration, the block flushed the command FIFO - drop any partial data and retry
+        while (hw->rxflr) (void)hw->data_cmd;
+        (void)hw->clr_tx_abrt;
+        background_errors++;
+        queueRead();
+        return;
+    }
+    if (status & I2C_IC_INTR_STAT_R_RX_FULL_BITS) {
+        uint8_t msb = (uint8_t)hw->data_cmd;
+        uint8_t lsb = (uint8_t)hw->data_cmd;
+        // publish into the slot that is not being read
+        uint8_t next = sample_index ^ 1;
+        samples[next].raw = ((msb << 8) | lsb) >> 2; // same layout as read()
+        // the sensor latches the angle during the transfer, date it to the middle
+        samples[next].timestamp = read_start + (time_us_32() - read_start) / 2;
+        sample_index = next;
+        background_count++;
+        queueRead();
+    }
+}
+
+void MT6701_I2C::i2c0Handler() {
+    if (background_sensor[0]) background_sensor[0]->handleInterrupt();
+}
+
+void MT6701_I2C::i2c1Handler() {
+    if (background_sensor[1]) background_sensor[1]->handleInterrupt();
 }
 
 // I2C functions
@@ -94,8 +226,13 @@ int MT6701_I2C::read(uint8_t angle_reg_msb) {
 
     // MT6701 uses 0..5 LSB and 6..13 MSB
     // Read data from register(s) over I2C
-    i2c_write_blocking(I2C_PORT, chip_address, &angle_register_msb, 1, true);
-    i2c_read_blocking(I2C_PORT, chip_address, readArray, 2, false);
+    // a failed transfer returns -1, which the Sensor base class treats as an error
+    if (i2c_write_blocking(I2C_PORT, chip_address, &angle_register_msb, 1, true) < 0 ||
+        i2c_read_blocking(I2C_PORT, chip_address, readArray, 2, false) < 0) {
+        currWireError = 1;
+        return -1;
+    }
+    currWireError = 0;
 
     // Data is split between 8 bits in Reg 0x03 and 6 bits in Reg 0x04
     readValue = ((readArray[0] << 8) | (readArray[1])) >> 2;
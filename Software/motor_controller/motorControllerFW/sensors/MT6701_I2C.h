@@ -6,6 +6,15 @@
 #include "hardware/i2c.h"
 #include "pico/stdlib.h"
 
+// priority of the background read interrupt, below the FOC step so a sample is never published while it is read
+#ifndef SIMPLEFOC_MT6701_IRQ_PRIORITY
+#define SIMPLEFOC_MT6701_IRQ_PRIORITY 0x80
+#endif
+// a background sample older than this counts as a failed read (bus stuck or sensor gone)
+#ifndef SIMPLEFOC_MT6701_STALE_US
+#define SIMPLEFOC_MT6701_STALE_US 2000
+#endif
+
 
 struct MT6701_I2CConfig_s  {
     int chip_address;
@@ -17,6 +26,12 @@ struct MT6701_I2CConfig_s  {
 // some predefined structures
 extern MT6701_I2CConfig_s sensor_default;
 
+/** one background sample of the angle register */
+struct MT6701_I2CSample_s {
+    uint16_t raw; //!< raw count
+    uint32_t timestamp; //!< time the angle was sampled, the middle of the read [us]
+};
+
 class MT6701_I2C: public Sensor{
  public:
     /**
@@ -41,15 +56,35 @@ class MT6701_I2C: public Sensor{
     // implementation of abstract functions of the Sensor class
     /** get current angle (rad) */
     float getSensorAngle() override;
+    /** get current angle as a binary angle (2^32 per turn) straight from the raw count */
+    int64_t getSensorAngleTurns() override;
+    /** time since the sample of the last angle: the middle of the read */
+    uint32_t getSensorAngleAge() override;
 
-    /** experimental function to check and fix SDA locked LOW issues */
+    /** experimental function to check and fix SDA locked LOW issues - not while reading in the background */
     void i2c_scan();
 
+    /**
+     * Start reading the angle register continuously in the background
+     * The I2C interrupt queues the next read as soon as one completes and publishes the samples
+     * into a double buffer, getSensorAngle() then just takes the newest sample instead of
+     * waiting for the bus. The interrupt is taken on the calling core.
+     * @returns 1 on success, 0 if the port is already used by another background sensor
+     */
+    int startBackgroundRead();
+    /** stop the background reads, getSensorAngle() reads blocking again */
+    void stopBackgroundRead();
+    /** newest background sample, consistent copy */
+    MT6701_I2CSample_s getSample();
+
     /** current error code from Wire endTransmission() call **/
     uint8_t currWireError = 0;
+    volatile uint32_t background_count = 0; //!< completed background reads
+    volatile uint32_t background_errors = 0; //!< aborted background reads
 
   private:
     float cpr; //!< Maximum range of the magnetic sensor
+    uint8_t turns_shift; //!< shift from the raw count to a 32 bit binary angle
     uint16_t lsb_used; //!< Number of bits used in LSB register
     uint8_t lsb_mask;
     uint8_t msb_mask;
@@ -73,6 +108,20 @@ class MT6701_I2C: public Sensor{
     uint8_t I2C_SDA_PIN;
     uint8_t I2C_SCL_PIN;
 
+    // background reads
+    bool background = false; //!< reading in the background
+    volatile MT6701_I2CSample_s samples[2]; //!< double buffer, written by the interrupt
+    volatile uint8_t sample_index = 0; //!< slot of the newest sample
+    uint32_t read_start = 0; //!< time the read in flight was queued [us]
+    uint32_t sample_time = 0; //!< sample time of the angle last returned by getRawCount() [us]
+    /** queue one read of the angle register */
+    void queueRead();
+    /** I2C interrupt of this sensor: publish the sample and queue the next read */
+    void handleInterrupt();
+    static void i2c0Handler();
+    static void i2c1Handler();
+    static MT6701_I2C* background_sensor[2]; //!< sensor reading in the background on each I2C port
+
 
 };
 
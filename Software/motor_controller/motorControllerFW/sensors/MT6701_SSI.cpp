@@ -0,0 +1,129 @@
+#include "MT6701_SSI.h"
+#include "hardware/dma.h"
+#include "hardware/timer.h"
+#include "mt6701_ssi.pio.h"
+
+static_assert(SIMPLEFOC_MT6701_SSI_LEAD_BITS + 24 <= MT6701_SSI_BITS, "the PIO program clocks too few bits");
+
+MT6701_SSI::MT6701_SSI(uint8_t _csn_pin, uint8_t _clk_pin, uint8_t _do_pin){
+    csn_pin = _csn_pin;
+    clk_pin = _clk_pin;
+    do_pin = _do_pin;
+}
+
+
+int MT6701_SSI::init(PIO _pio) {
+    pio = _pio;
+    if (!pio_can_add_program(pio, &mt6701_ssi_program)) return 0;
+    sm = pio_claim_unused_sm(pio, false);
+    if (sm < 0) return 0;
+    int read_channel = dma_claim_unused_channel(false);
+    int stamp_channel = dma_claim_unused_channel(false);
+    if (read_channel < 0 || stamp_channel < 0) {
+        if (read_channel >= 0) dma_channel_unclaim(read_channel);
+        if (stamp_channel >= 0) dma_channel_unclaim(stamp_channel);
+        pio_sm_unclaim(pio, sm);
+        sm = -1;
+        return 0;
+    }
+    read_dma = read_channel;
+    stamp_dma = stamp_channel;
+
+    // read: one frame per RX FIFO entry into the frame ring, then the stamp
+    dma_channel_config cr = dma_channel_get_default_config(read_dma);
+    channel_config_set_transfer_data_size(&cr, DMA_SIZE_32);
+    channel_config_set_read_increment(&cr, false);
+    channel_config_set_write_increment(&cr, true);
+    channel_config_set_ring(&cr, true, __builtin_ctz(sizeof(frames)));
+    channel_config_set_dreq(&cr, pio_get_dreq(pio, sm, false));
+    channel_config_set_chain_to(&cr, stamp_dma);
+    channel_config_set_irq_quiet(&cr, true);
+    dma_channel_configure(read_dma, &cr, frames, &pio->rxf[sm], 1, false);
+    // stamp: timer into the timestamp ring, then wait for the next frame
+    dma_channel_config cs = dma_channel_get_default_config(stamp_dma);
+    channel_config_set_transfer_data_size(&cs, DMA_SIZE_32);
+    channel_config_set_read_increment(&cs, false);
+    channel_config_set_write_increment(&cs, true);
+    channel_config_set_ring(&cs, true, __builtin_ctz(sizeof(timestamps)));
+    channel_config_set_chain_to(&cs, read_dma);
+    channel_config_set_irq_quiet(&cs, true);
+    dma_channel_configure(stamp_dma, &cs, timestamps, &timer_hw->timerawl, 1, false);
+    dma_channel_start(read_dma);
+
+    uint offset = pio_add_program(pio, &mt6701_ssi_program);
+    mt6701_ssi_program_init(pio, sm, offset, csn_pin, clk_pin, do_pin, SIMPLEFOC_MT6701_SSI_CLOCK);
+
+    // wait for the first frames, the base class init reads the angle
+    sleep_us(100);
+    this->Sensor::init();
+    return 1;
+}
+
+
+MT6701_SSISample_s MT6701_SSI::getSample() {
+    // the newest frame is the one before the write position of the read channel, it is complete
+    // once the stamp channel caught up - retry if a new frame arrived during the copy
+    MT6701_SSISample_s sample;
+    while (true) {
+        uint32_t frame_pos = dma_hw->ch[read_dma].write_addr - (uintptr_t)frames;
+        uint32_t stamp_pos = dma_hw->ch[stamp_dma].write_addr - (uintptr_t)timestamps;
+        if (frame_pos != stamp_pos) continue; // stamp of the last frame pending
+        uint32_t index = (frame_pos / sizeof(uint32_t) + MT6701_SSI_RING - 1) & (MT6701_SSI_RING - 1);
+        sample.frame = frames[index];
+        sample.timestamp = timestamps[index];
+        if (dma_hw->ch[read_dma].write_addr - (uintptr_t)frames == frame_pos) break;
+    }
+    return sample;
+}
+
+
+// CRC6, polynomial x^6 + x + 1, initial value 0, MSB first over 18 bits
+uint8_t MT6701_SSI::crc6(uint32_t data) {
+    uint8_t crc = 0;
+    for (int i = 17; i >= 0; i--) {
+        uint8_t bit = ((data >> i) & 1) ^ ((crc >> 5) & 1);
+        crc = (crc << 1) & 0x3F;
+        if (bit) crc ^= 0x03;
+    }
+    return crc;
+}
+
+
+int MT6701_SSI::getRawCount() {
+    MT6701_SSISample_s sample = getSample();
+    if ((uint32_t)(time_us_32() - sample.timestamp) > SIMPLEFOC_MT6701_SSI_STALE_US) {
+        error = 1;
+        return -1;
+    }
+    // drop the lead bits and anything clocked in after the crc
+    uint32_t data = (sample.frame >> (MT6701_SSI_BITS - 24 - SIMPLEFOC_MT6701_SSI_LEAD_BITS)) & 0xFFFFFF;
+    if (crc6(data >> 6) != (data & 0x3F)) {
+        crc_errors++;
+        error = 1;
+        return -1;
+    }
+    error = 0;
+    status = (data >> 6) & 0x0F;
+    // stamped when the frame is in, the angle is latched when CSN falls at its start
+    sample_time = sample.timestamp - (uint32_t)(MT6701_SSI_BITS * 1e6f / SIMPLEFOC_MT6701_SSI_CLOCK);
+    return data >> 10;
+}
+
+
+uint32_t MT6701_SSI::getSensorAngleAge() {
+    return time_us_32() - sample_time;
+}
+
+
+//  Shaft angle calculation
+//  angle is in radians [rad]
+float MT6701_SSI::getSensorAngle(){
+    return ( getRawCount() / 16384.0f ) * _2PI;
+}
+
+//  Shaft angle as a binary angle, the 14 bit count is left aligned into the 32 bit turn
+int64_t MT6701_SSI::getSensorAngleTurns(){
+    int raw = getRawCount();
+    if (raw < 0) return -1;
+    return (int64_t)((uint32_t)raw << 18);
+}
@@ -0,0 +1,88 @@
+#ifndef MT6701_SSI_LIB_H
+#define MT6701_SSI_LIB_H
+
+#include "common/base_classes/Sensor.h"
+#include "common/foc_utils.h"
+#include "hardware/pio.h"
+#include "pico/stdlib.h"
+
+// SSI clock, a frame of the PIO program is 474 SM cycles (CSN setup, 25 bits of 8 cycles, the 256 cycle
+// idle gap) at 8 cycles per SSI bit: ~30us at 2MHz -> ~34k angles/s
+#ifndef SIMPLEFOC_MT6701_SSI_CLOCK
+#define SIMPLEFOC_MT6701_SSI_CLOCK 2000000.0f
+#endif
+// bits clocked in before the angle MSB, the PIO program clocks MT6701_SSI_BITS = 24 data bits + 1
+#ifndef SIMPLEFOC_MT6701_SSI_LEAD_BITS
+#define SIMPLEFOC_MT6701_SSI_LEAD_BITS 1
+#endif
+// a frame older than this counts as a failed read (state machine or DMA stopped)
+#ifndef SIMPLEFOC_MT6701_SSI_STALE_US
+#define SIMPLEFOC_MT6701_SSI_STALE_US 200
+#endif
+
+#define MT6701_SSI_RING 4 //!< frames kept by the DMA ring, power of 2
+
+/** one SSI frame as clocked in by the PIO */
+struct MT6701_SSISample_s {
+    uint32_t frame; //!< raw frame, data in the low 24 bits: angle (14) | status (4) | crc (6)
+    uint32_t timestamp; //!< time the frame was received [us]
+};
+
+/**
+ * MT6701 over its 3 wire SSI interface (CSN, CLK, DO)
+ *
+ * A PIO state machine clocks frames continuously, a DMA channel moves each frame from the RX FIFO
+ * into a ring and chains to a second one that copies the timer into a parallel ring of timestamps,
+ * which chains back - no CPU involved. getSensorAngle() takes the newest frame and checks its CRC.
+ * The state machine and both DMA channels are claimed in init(), on pio1 by default (can2040 uses pio0).
+ */
+class MT6701_SSI: public Sensor{
+ public:
+    /**
+     * MT6701_SSI class constructor
+     * @param csn_pin  chip select pin
+     * @param clk_pin  clock pin
+     * @param do_pin  data out pin of the sensor
+     */
+    MT6701_SSI(uint8_t csn_pin, uint8_t clk_pin, uint8_t do_pin);
+
+    /**
+     * start the PIO and DMA acquisition and initialise the Sensor base class
+     * @param pio  PIO block to use
+     * @returns 1 on success, 0 if no state machine, program space or DMA channel was free
+     */
+    int init(PIO pio = pio1);
+
+    // implementation of abstract functions of the Sensor class
+    /** get current angle (rad) */
+    float getSensorAngle() override;
+    /** get current angle as a binary angle (2^32 per turn) straight from the raw count */
+    int64_t getSensorAngleTurns() override;
+    /** time since the sample of the last angle: the start of its frame */
+    uint32_t getSensorAngleAge() override;
+
+    /** newest frame and its timestamp, consistent copy */
+    MT6701_SSISample_s getSample();
+    /** CRC6 (x^6 + x + 1) of the 18 angle and status bits */
+    static uint8_t crc6(uint32_t data);
+
+    uint8_t status = 0; //!< status bits of the last good frame: field strength (1:0), push button (2), track loss (3)
+    uint32_t crc_errors = 0; //!< reads rejected by the CRC
+    uint8_t error = 0; //!< 1 if the last read failed (CRC or stale frame)
+
+  private:
+    /** raw 14 bit angle of the newest frame, -1 on error */
+    int getRawCount();
+    uint32_t sample_time = 0; //!< sample time of the angle last returned by getRawCount() [us]
+
+    uint8_t csn_pin, clk_pin, do_pin;
+    PIO pio = nullptr;
+    int sm = -1;
+    uint read_dma; //!< frames from the RX FIFO into the ring
+    uint stamp_dma; //!< timer into the timestamp ring, after every frame
+    alignas(4 * MT6701_SSI_RING) volatile uint32_t frames[MT6701_SSI_RING] = {0}; //!< frame ring, aligned for the DMA write ring
+    alignas(4 * MT6701_SSI_RING) volatile uint32_t timestamps[MT6701_SSI_RING] = {0}; //!< timestamp ring, same index as frames
+};
+
+
+#endif
@@ -0,0 +1,79 @@
+#include "SmoothingSensor.h"
+
+SmoothingSensor::SmoothingSensor(Sensor& _wrapped, const FOCMotor& _motor)
+  : wrapped(_wrapped), motor(_motor)
+{
+}
+
+
+void SmoothingSensor::init() {
+  // hand over a calibration linked to this sensor, never clear the one of the wrapped sensor
+  if (calibration) wrapped.calibration = calibration;
+  wrapped.update();
+  sensor_cnt = 0;
+  angle_prev_turns = wrapped.angle_prev_turns;
+  angle_prev = wrapped.angle_prev;
+  angle_prev_ts = wrapped.angle_prev_ts;
+  full_rotations = wrapped.full_rotations;
+  vel_angle_prev_turns = angle_prev_turns;
+  vel_angle_prev = angle_prev;
+  vel_angle_prev_ts = angle_prev_ts;
+  vel_full_rotations = full_rotations;
+}
+
+
+void SmoothingSensor::update() {
+  // real reading, downsampled
+  if (sensor_cnt++ >= sensor_downsample) {
+    sensor_cnt = 0;
+    if (calibration) wrapped.calibration = calibration;
+    wrapped.update();
+  }
+
+  // predict from the sample time of the last reading to now, with the velocity of the real readings
+  // (not the motor's estimate: the estimator is fed from this sensor, so it would extrapolate its own prediction)
+  unsigned long now = time_us_64();
+  float dt = ((uint32_t)now - (uint32_t)wrapped.angle_prev_ts) * 1e-6f;
+  float velocity = wrapped.getVelocity();
+  float advance = velocity * dt;
+  // at most 60 electrical degrees from the last reading (one step of block commutation)
+  float limit = _PI_3 / motor.pole_pairs;
+  advance = _constrain(advance, -limit, limit);
+  if (phase_correction != 0.0f && velocity != 0.0f)
+    advance += (velocity > 0.0f ? phase_correction : -phase_correction) / motor.pole_pairs;
+
+  int32_t advance_turns = (int32_t)(advance * _RAD_TO_TURNS32);
+  uint32_t turns = wrapped.angle_prev_turns + (uint32_t)advance_turns;
+  full_rotations = wrapped.full_rotations;
+  // the prediction may cross the zero
+  if (advance_turns > 0 && turns < wrapped.angle_prev_turns) full_rotations += 1;
+  else if (advance_turns < 0 && turns > wrapped.angle_prev_turns) full_rotations -= 1;
+  angle_prev_turns = turns;
+  angle_prev = turns * _TURNS32_TO_RAD;
+  angle_prev_ts = now;
+}
+
+
+float SmoothingSensor::getVelocity() {
+  return wrapped.getVelocity();
+}
+
+
+int SmoothingSensor::needsSearch() {
+  return wrapped.needsSearch();
+}
+
+
+float SmoothingSensor::getSensorAngle() {
+  return wrapped.getSensorAngle();
+}
+
+
+int64_t SmoothingSensor::getSensorAngleTurns() {
+  return wrapped.getSensorAngleTurns();
+}
+
+
+uint32_t SmoothingSensor::getSensorAngleAge() {
+  return wrapped.getSensorAngleAge();
+}
@@ -0,0 +1,52 @@
+#ifndef SMOOTHING_SENSOR_H
+#define SMOOTHING_SENSOR_H
+
+#include "common/base_classes/Sensor.h"
+#include "common/base_classes/FOCMotor.h"
+
+/**
+ * Smoothing sensor wrapper
+ *
+ * Wraps a slow sensor (e.g. MT6701_I2C read blocking) and predicts the angle between its readings
+ * from the velocity of its readings, so loopFOC() can run several times per real sensor sample:
+ * the wrapped sensor is only updated every sensor_downsample+1 calls of update().
+ * The prediction starts from the sample time of the last reading (see Sensor::getSensorAngleAge()) and
+ * is limited to 60 electrical degrees, so a stalled sensor can not run away.
+ * The predicted angle is dated to the update, the motor latency compensation then only adds the output latency.
+ *
+ * The velocity is the one of the wrapped sensor, as returned by getVelocity(): the motor's velocity estimator
+ * is fed from this sensor, predicting from it would feed the prediction back into itself.
+ * A calibration linked to this sensor is handed to the wrapped one, the correction applies to the real readings.
+ * Without one the calibration of the wrapped sensor is kept.
+ */
+class SmoothingSensor : public Sensor {
+  public:
+    /**
+     * SmoothingSensor class constructor
+     * @param wrapped  sensor to smooth, initialised by the caller
+     * @param motor  motor the sensor is linked to, provides the pole pairs
+     */
+    SmoothingSensor(Sensor& wrapped, const FOCMotor& motor);
+
+    /** start from the current reading of the wrapped sensor */
+    void init() override;
+    /** update the wrapped sensor every sensor_downsample+1 calls and predict the angle in between */
+    void update() override;
+    /** velocity of the wrapped sensor */
+    float getVelocity() override;
+    int needsSearch() override;
+
+    unsigned int sensor_downsample = 0; //!< updates of this sensor skipped between real readings
+    float phase_correction = 0.0f; //!< electrical angle [rad] added in the direction of motion, for a constant lag of the wrapped sensor
+
+  protected:
+    float getSensorAngle() override;
+    int64_t getSensorAngleTurns() override;
+    uint32_t getSensorAngleAge() override;
+
+    Sensor& wrapped;
+    const FOCMotor& motor;
+    unsigned int sensor_cnt = 0; //!< updates since the last real reading
+};
+
+#endif